@@ -0,0 +1,100 @@
+#include "apiregistry.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace {
+
+// APIs are stored in fixed-size chunks, which are never moved, so they can be read without locking
+constexpr int ChunkBits = 8;
+constexpr ApiId ChunkSize = 1 << ChunkBits;
+constexpr int MaxChunks = 256;
+
+struct Registry
+{
+    QMutex mutex;
+    QHash<QString, ApiId> ids;
+    QSet<QString> properties;
+    std::array<std::atomic<ApiRegistry::ApiInfo *>, MaxChunks> chunks = {};
+    std::atomic<ApiId> count = 0;
+
+    ~Registry()
+    {
+        for (auto &chunk : chunks)
+            delete[] chunk.load();
+    }
+};
+
+Registry &registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+} // namespace
+
+ApiId ApiRegistry::registerApi(const QString &name)
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+
+    auto it = r.ids.constFind(name);
+    if (it != r.ids.cend())
+        return it.value();
+
+    const ApiId id = r.count.load(std::memory_order_relaxed);
+    const auto chunkIndex = id >> ChunkBits;
+    Q_ASSERT_X(chunkIndex < MaxChunks, "ApiRegistry::registerApi", "Too many APIs registered");
+    auto *chunk = r.chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new ApiInfo[ChunkSize];
+        r.chunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+
+    auto &info = chunk[id & (ChunkSize - 1)];
+    info.name = name;
+    info.jsName = QString(name).replace("::", ".");
+    info.isProperty.store(r.properties.contains(name), std::memory_order_relaxed);
+
+    r.ids.insert(name, id);
+    r.count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+ApiId ApiRegistry::find(const QString &name)
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.ids.value(name, InvalidApi);
+}
+
+bool ApiRegistry::isValid(ApiId id)
+{
+    return id < registry().count.load(std::memory_order_acquire);
+}
+
+const ApiRegistry::ApiInfo &ApiRegistry::info(ApiId id)
+{
+    Q_ASSERT(isValid(id));
+    const auto *chunk = registry().chunks[id >> ChunkBits].load(std::memory_order_acquire);
+    return chunk[id & (ChunkSize - 1)];
+}
+
+void ApiRegistry::addProperty(const QString &name)
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+
+    r.properties.insert(name);
+    auto it = r.ids.constFind(name);
+    if (it != r.ids.cend()) {
+        auto *chunk = r.chunks[it.value() >> ChunkBits].load(std::memory_order_relaxed);
+        // Read without lock by the other threads
+        chunk[it.value() & (ChunkSize - 1)].isProperty.store(true, std::memory_order_release);
+    }
+}
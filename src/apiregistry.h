@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QMetaObject>
+#include <QMetaProperty>
+#include <QString>
+
+#include <atomic>
+
+using ApiId = quint32;
+
+/**
+ * @brief The ApiRegistry class keeps the list of all logged APIs
+ *
+ * Each API is registered once, the first time it is logged, and gets an id used everywhere else in the history
+ * (comparison, merge, script creation...). The javascript spelling and whether the API is a property are computed at
+ * registration time.
+ * Registration is thread-safe, and lookup by id is lock-free.
+ */
+class ApiRegistry
+{
+public:
+    struct ApiInfo
+    {
+        QString name;
+        QString jsName;
+        // Can be set after registration, when the properties of a class are added
+        std::atomic_bool isProperty = false;
+    };
+
+    /**
+     * Register an API by its C++ name (Class::method), returns the existing id if already registered.
+     */
+    static ApiId registerApi(const QString &name);
+    /**
+     * Returns the id of an API, or InvalidApi if it's not registered.
+     */
+    static ApiId find(const QString &name);
+    static const ApiInfo &info(ApiId id);
+    static bool isValid(ApiId id);
+
+    static constexpr ApiId InvalidApi = ~ApiId(0);
+
+    template <typename Object>
+    static void addProperties()
+    {
+        const QString className = QString(Object::staticMetaObject.className()).split("::").last();
+        for (int i = 0; i < Object::staticMetaObject.propertyCount(); ++i)
+            addProperty(QString("%1::%2").arg(className, Object::staticMetaObject.property(i).name()));
+    }
+
+private:
+    static void addProperty(const QString &name);
+};
+
+/**
+ * Returns the id of the API, it is registered only once per call site.
+ */
+#define LOG_API_ID(name)                                                                                               \
+    ([]() -> ApiId {                                                                                                   \
+        static const ApiId __apiId = ApiRegistry::registerApi(QStringLiteral(name));                                   \
+        return __apiId;                                                                                                \
+    }())
@@ -0,0 +1,155 @@
+#include "apisemantics.h"
+
+#include <QHash>
+
+namespace {
+
+struct Semantics
+{
+    const char *name;
+    ApiSemantics::Kind kind;
+    bool mergeable = false;
+};
+
+// clang-format off
+constexpr Semantics TextDocumentSemantics[] = {
+    {"TextDocument::gotoStartOfLine", ApiSemantics::Move},
+    {"TextDocument::gotoEndOfLine", ApiSemantics::Move},
+    {"TextDocument::gotoStartOfWord", ApiSemantics::Move},
+    {"TextDocument::gotoEndOfWord", ApiSemantics::Move},
+    {"TextDocument::gotoPreviousLine", ApiSemantics::Move, true},
+    {"TextDocument::gotoNextLine", ApiSemantics::Move, true},
+    {"TextDocument::gotoPreviousChar", ApiSemantics::Move, true},
+    {"TextDocument::gotoNextChar", ApiSemantics::Move, true},
+    {"TextDocument::gotoPreviousWord", ApiSemantics::Move, true},
+    {"TextDocument::gotoNextWord", ApiSemantics::Move, true},
+    {"TextDocument::gotoStartOfDocument", ApiSemantics::AbsoluteMove},
+    {"TextDocument::gotoEndOfDocument", ApiSemantics::AbsoluteMove},
+    {"TextDocument::unselect", ApiSemantics::Unselect},
+    {"TextDocument::selectAll", ApiSemantics::SelectAll},
+    {"TextDocument::selectStartOfLine", ApiSemantics::Select},
+    {"TextDocument::selectEndOfLine", ApiSemantics::Select},
+    {"TextDocument::selectStartOfWord", ApiSemantics::Select},
+    {"TextDocument::selectEndOfWord", ApiSemantics::Select},
+    {"TextDocument::selectPreviousLine", ApiSemantics::Select, true},
+    {"TextDocument::selectNextLine", ApiSemantics::Select, true},
+    {"TextDocument::selectPreviousChar", ApiSemantics::Select, true},
+    {"TextDocument::selectNextChar", ApiSemantics::Select, true},
+    {"TextDocument::selectPreviousWord", ApiSemantics::Select, true},
+    {"TextDocument::selectNextWord", ApiSemantics::Select, true},
+    {"TextDocument::remove", ApiSemantics::Delete, true},
+    {"TextDocument::insert", ApiSemantics::Insert, true},
+    {"TextDocument::deleteSelection", ApiSemantics::DeleteSelection},
+    {"TextDocument::deleteEndOfLine", ApiSemantics::Delete},
+    {"TextDocument::deleteStartOfLine", ApiSemantics::Delete},
+    {"TextDocument::deleteEndOfWord", ApiSemantics::Delete},
+    {"TextDocument::deleteStartOfWord", ApiSemantics::Delete},
+    {"TextDocument::deletePreviousCharacter", ApiSemantics::DeleteCharacters, true},
+    {"TextDocument::deleteNextCharacter", ApiSemantics::DeleteCharacters, true},
+    {"TextDocument::find", ApiSemantics::Find},
+    {"TextDocument::findAll", ApiSemantics::Read},
+    {"TextDocument::count", ApiSemantics::Read},
+    {"TextDocument::replaceAll", ApiSemantics::Replace},
+    {"TextDocument::currentWord", ApiSemantics::Read},
+    {"TextDocument::selectedText", ApiSemantics::Read},
+};
+// clang-format on
+
+// The APIs are registered here, so the table can be keyed by id even before they are logged
+QHash<ApiId, ApiSemantics::Info> createTable()
+{
+    QHash<ApiId, ApiSemantics::Info> table;
+    for (const auto &semantics : TextDocumentSemantics) {
+        ApiSemantics::Info info;
+        info.kind = semantics.kind;
+        info.mergeable = semantics.mergeable;
+        table.insert(ApiRegistry::registerApi(QString::fromLatin1(semantics.name)), info);
+    }
+    return table;
+}
+
+} // namespace
+
+const ApiSemantics::Info &ApiSemantics::info(ApiId id)
+{
+    static const QHash<ApiId, Info> table = createTable();
+    static const Info unknown;
+
+    auto it = table.constFind(id);
+    return it == table.cend() ? unknown : it.value();
+}
+
+bool ApiSemantics::isCursorOnly(Kind kind)
+{
+    switch (kind) {
+    case Move:
+    case AbsoluteMove:
+    case Select:
+    case SelectAll:
+    case Unselect:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ApiSemantics::clearsSelection(Kind kind)
+{
+    switch (kind) {
+    case Move:
+    case AbsoluteMove:
+    case Unselect:
+    case Insert:
+    case DeleteCharacters:
+    case DeleteSelection:
+    case Delete:
+        return true;
+    default:
+        return false;
+    }
+}
+
+ApiSemantics::Effects ApiSemantics::effects(Kind kind)
+{
+    switch (kind) {
+    case Unknown:
+        return {AllStates, AllStates, NoState};
+    // A character move without the anchor collapses the selection first, a find starts from its end
+    case Move:
+        return {AllStates, Position | Anchor, NoState};
+    case AbsoluteMove:
+    case SelectAll:
+        return {Text, Position | Anchor, Position | Anchor};
+    case Select:
+        return {Text | Position, Position, NoState};
+    case Unselect:
+        return {Position, Anchor, Anchor};
+    case Insert:
+    case DeleteCharacters:
+    case DeleteSelection:
+    case Delete:
+        return {AllStates, AllStates, NoState};
+    case Read:
+        return {AllStates, NoState, NoState};
+    case Find:
+        return {AllStates, Position | Anchor, NoState};
+    case Replace:
+        return {AllStates, AllStates, NoState};
+    }
+    return {};
+}
+
+ApiId ApiSemantics::deleteSelectionApi()
+{
+    return LOG_API_ID("TextDocument::deleteSelection");
+}
+
+ApiId ApiSemantics::deletePreviousCharacterApi()
+{
+    return LOG_API_ID("TextDocument::deletePreviousCharacter");
+}
+
+ApiId ApiSemantics::insertApi()
+{
+    return LOG_API_ID("TextDocument::insert");
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "apiregistry.h"
+
+/**
+ * @brief The ApiSemantics class describes the effect of the TextDocument APIs on the document
+ *
+ * It is used to transform recorded scripts: an API not described here is handled as an unknown operation, which is
+ * never changed, removed or moved.
+ */
+class ApiSemantics
+{
+public:
+    enum Kind {
+        Unknown,
+        Move, // Relative move, with no selection afterwards
+        AbsoluteMove, // Move to a position independent of the current one, with no selection afterwards
+        Select, // Relative move, keeping the anchor
+        SelectAll,
+        Unselect,
+        Insert,
+        DeleteCharacters, // Delete characters around the cursor, with no selection afterwards
+        DeleteSelection,
+        Delete, // Other deletions, with no selection afterwards
+        Read, // Read the document, without changing it
+        Find, // Read the document, and change the cursor and selection
+        Replace, // Change the text anywhere in the document, the cursor and selection follow the text
+    };
+
+    // Document state read or written by an operation
+    enum State {
+        NoState = 0x0,
+        Text = 0x1,
+        Position = 0x2,
+        Anchor = 0x4,
+        AllStates = Text | Position | Anchor,
+    };
+
+    struct Effects
+    {
+        int reads = AllStates;
+        int writes = AllStates;
+        // States written without reading them: their previous value doesn't matter
+        int kills = NoState;
+    };
+
+    struct Info
+    {
+        Kind kind = Unknown;
+        // Operations recorded with LOG_AND_MERGE, merged by adding their count or concatenating their text
+        bool mergeable = false;
+    };
+
+    static const Info &info(ApiId id);
+
+    /**
+     * Returns true if the operation only changes the cursor and selection, not the text.
+     */
+    static bool isCursorOnly(Kind kind);
+    /**
+     * Returns true if there is no selection after the operation, whatever the state before.
+     */
+    static bool clearsSelection(Kind kind);
+    /**
+     * Returns the document states read and written by the operation, unknown operations read and write everything.
+     */
+    static Effects effects(Kind kind);
+
+    static ApiId deleteSelectionApi();
+    static ApiId deletePreviousCharacterApi();
+    static ApiId insertApi();
+};
@@ -0,0 +1,96 @@
+#include "batchrunner.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QLoggingCategory>
+#include <QThread>
+
+#include <cstdio>
+
+// Input files, with the output file name relative to the output directory
+static std::vector<BatchRunner::Job> createJobs(const QStringList &inputs, const QDir &outputDir)
+{
+    std::vector<BatchRunner::Job> jobs;
+    for (const auto &input : inputs) {
+        const QFileInfo info(input);
+        if (!info.isDir()) {
+            jobs.push_back({info.filePath(), outputDir.filePath(info.fileName())});
+            continue;
+        }
+        const QDir inputDir(input);
+        QDirIterator it(input, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString fileName = it.next();
+            jobs.push_back({fileName, outputDir.filePath(inputDir.relativeFilePath(fileName))});
+        }
+    }
+    return jobs;
+}
+
+int main(int argc, char *argv[])
+{
+    // Documents are never shown
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("scriptbatch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Apply a recorded script to a set of files.");
+    parser.addHelpOption();
+    QCommandLineOption outputOption({"o", "output"}, "Directory where the results are written.", "directory");
+    parser.addOption(outputOption);
+    QCommandLineOption jobsOption({"j", "jobs"}, "Number of worker threads, one per core by default.", "count");
+    parser.addOption(jobsOption);
+    QCommandLineOption timeoutOption({"t", "timeout"}, "Time limit per file in milliseconds, 0 for none.", "msec",
+                                     "60000");
+    parser.addOption(timeoutOption);
+    parser.addPositionalArgument("script", "Script to apply.");
+    parser.addPositionalArgument("inputs", "Files, or directories to process recursively.", "inputs...");
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() < 2 || !parser.isSet(outputOption))
+        parser.showHelp(1);
+
+    QFile scriptFile(arguments.first());
+    if (!scriptFile.open(QIODevice::ReadOnly)) {
+        qCritical() << "Can't read the script" << arguments.first();
+        return 1;
+    }
+    const QString script = QString::fromUtf8(scriptFile.readAll());
+
+    int workerCount = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption))
+        workerCount = parser.value(jobsOption).toInt();
+    if (workerCount <= 0) {
+        qCritical() << "Invalid number of jobs" << parser.value(jobsOption);
+        return 1;
+    }
+
+    bool isTimeoutValid = false;
+    const int timeout = parser.value(timeoutOption).toInt(&isTimeoutValid);
+    if (!isTimeoutValid || timeout < 0) {
+        qCritical() << "Invalid timeout" << parser.value(timeoutOption);
+        return 1;
+    }
+
+    // The script runner traces each run, only keep warnings
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    auto jobs = createJobs(arguments.mid(1), QDir(parser.value(outputOption)));
+    if (!BatchRunner::checkOutputCollisions(jobs))
+        return 1;
+    const int jobCount = static_cast<int>(jobs.size());
+    BatchRunner runner(script, std::min(workerCount, std::max(jobCount, 1)));
+    runner.setTimeBudget(timeout);
+    const auto result = runner.run(std::move(jobs));
+
+    fprintf(stderr, "%d files processed, %d failed\n", result.succeeded, result.failed);
+    return result.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "batchrunner.h"
+#include "scriptrunner.h"
+#include "textdocument.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QThread>
+
+BatchRunner::BatchRunner(const QString &script, int workerCount)
+    : m_script(script)
+{
+    Q_ASSERT(workerCount > 0);
+    for (int i = 0; i < workerCount; ++i)
+        m_queues.push_back(std::make_unique<Queue>());
+}
+
+BatchRunner::~BatchRunner() = default;
+
+// Inputs with the same file name, given separately or in different directories, would overwrite each other's output
+bool BatchRunner::checkOutputCollisions(const std::vector<Job> &jobs)
+{
+    QHash<QString, QString> inputs;
+    for (const auto &job : jobs) {
+        QString key = QDir::cleanPath(QFileInfo(job.outputFile).absoluteFilePath());
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+        key = key.toCaseFolded();
+#endif
+        const auto it = inputs.constFind(key);
+        if (it != inputs.cend()) {
+            qCritical() << "The inputs" << it.value() << "and" << job.inputFile << "have the same output"
+                        << job.outputFile;
+            return false;
+        }
+        inputs.insert(key, job.inputFile);
+    }
+    return true;
+}
+
+BatchRunner::Result BatchRunner::run(std::vector<Job> jobs)
+{
+    m_succeeded = 0;
+    m_failed = 0;
+
+    // Contiguous ranges per worker, stealing balances the rest
+    const size_t workerCount = m_queues.size();
+    for (size_t i = 0; i < jobs.size(); ++i)
+        m_queues[i * workerCount / jobs.size()]->jobs.push_back(std::move(jobs[i]));
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (size_t i = 0; i < workerCount; ++i) {
+        threads.emplace_back(QThread::create(&BatchRunner::work, this, static_cast<int>(i)));
+        threads.back()->start();
+    }
+    for (auto &thread : threads)
+        thread->wait();
+
+    return {m_succeeded.load(), m_failed.load()};
+}
+
+void BatchRunner::work(int worker)
+{
+    // Everything is created in the worker thread, the QML engine and its singleton belong to it
+    TextDocument document;
+    ScriptRunner runner(&document);
+    runner.setTimeBudget(m_timeBudget);
+
+    Job job;
+    while (takeJob(worker, job)) {
+        if (runJob(runner, document, job))
+            ++m_succeeded;
+        else
+            ++m_failed;
+    }
+}
+
+bool BatchRunner::takeJob(int worker, Job &job)
+{
+    // Own jobs are taken from the front, stolen jobs from the back of the other queues
+    {
+        auto &queue = *m_queues[worker];
+        QMutexLocker locker(&queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+    const int workerCount = static_cast<int>(m_queues.size());
+    for (int i = 1; i < workerCount; ++i) {
+        auto &victim = *m_queues[(worker + i) % workerCount];
+        QMutexLocker locker(&victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    // No job is added while running, all queues are empty
+    return false;
+}
+
+bool BatchRunner::runJob(ScriptRunner &runner, TextDocument &document, const Job &job)
+{
+    // The input is mapped, large files aren't loaded in memory
+    if (!document.open(job.inputFile)) {
+        qWarning() << "Can't read" << job.inputFile;
+        return false;
+    }
+
+    runner.runScript(m_script);
+    if (runner.hasError()) {
+        qWarning() << "Script failed on" << job.inputFile << runner.errors();
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(job.outputFile).absolutePath());
+    QSaveFile output(job.outputFile);
+    if (!output.open(QIODevice::WriteOnly) || !document.save(&output) || !output.commit()) {
+        qWarning() << "Can't write" << job.outputFile;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class ScriptRunner;
+class TextDocument;
+
+/**
+ * @brief The BatchRunner class applies a script to many files, using all cores
+ *
+ * Each worker thread has its own headless TextDocument, ScriptRunner and QML engine, so the script is compiled once
+ * per worker. Jobs are split between the workers, a worker without jobs left steals them from the others, so slow
+ * files don't leave cores idle.
+ */
+class BatchRunner
+{
+public:
+    struct Job
+    {
+        QString inputFile;
+        QString outputFile;
+    };
+
+    struct Result
+    {
+        int succeeded = 0;
+        int failed = 0;
+    };
+
+    explicit BatchRunner(const QString &script, int workerCount);
+    ~BatchRunner();
+
+    /**
+     * Maximum duration of the script on one file in milliseconds, 0 for no limit. A job running for longer is
+     * interrupted and counted as failed, the other jobs go on.
+     */
+    void setTimeBudget(int msec) { m_timeBudget = msec; }
+    int timeBudget() const { return m_timeBudget; }
+
+    /**
+     * Returns false if two jobs have the same output file, which would be overwritten.
+     */
+    static bool checkOutputCollisions(const std::vector<Job> &jobs);
+
+    /**
+     * Run the script on all jobs, returns when all of them are done.
+     */
+    Result run(std::vector<Job> jobs);
+
+private:
+    struct Queue
+    {
+        QMutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void work(int worker);
+    bool takeJob(int worker, Job &job);
+    bool runJob(ScriptRunner &runner, TextDocument &document, const Job &job);
+
+    const QString m_script;
+    int m_timeBudget = 0;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic_int m_succeeded = 0;
+    std::atomic_int m_failed = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QIODevice>
+#include <QString>
+
+/**
+ * @brief The ChunkedWriter class writes text to a device in fixed-size chunks
+ *
+ * Text is accumulated in a buffer, and written encoded in UTF-8 each time the buffer reaches the chunk size, so the
+ * memory used stays bounded whatever the size of the text written.
+ */
+class ChunkedWriter
+{
+public:
+    explicit ChunkedWriter(QIODevice *device, qsizetype chunkSize = DefaultChunkSize)
+        : m_device(device)
+        , m_chunkSize(chunkSize)
+    {
+        Q_ASSERT(device && device->isWritable());
+        m_buffer.reserve(chunkSize + chunkSize / 4);
+    }
+    ~ChunkedWriter() { flush(); }
+
+    ChunkedWriter &operator+=(QStringView text)
+    {
+        m_buffer.append(text);
+        if (m_buffer.size() >= m_chunkSize)
+            flush();
+        return *this;
+    }
+    ChunkedWriter &operator+=(QChar c) { return *this += QStringView(&c, 1); }
+    ChunkedWriter &operator+=(const QString &text) { return *this += QStringView(text); }
+
+    bool flush()
+    {
+        if (m_buffer.isEmpty())
+            return !m_hasError;
+        const QByteArray data = m_buffer.toUtf8();
+        const qint64 written = m_device->write(data);
+        m_hasError = m_hasError || written != data.size();
+        m_bytesWritten += qMax<qint64>(written, 0);
+        m_buffer.resize(0);
+        return !m_hasError;
+    }
+
+    bool hasError() const { return m_hasError; }
+    qint64 bytesWritten() const { return m_bytesWritten; }
+
+    static constexpr qsizetype DefaultChunkSize = 64 * 1024;
+
+private:
+    QIODevice *m_device;
+    const qsizetype m_chunkSize;
+    QString m_buffer;
+    qint64 m_bytesWritten = 0;
+    bool m_hasError = false;
+};
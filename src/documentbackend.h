@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QString>
+#include <QTextCursor>
+
+#include <functional>
+
+class QIODevice;
+
+/**
+ * @brief The DocumentBackend class is the text and cursor behind a TextDocument
+ *
+ * A backend has one cursor, with a position and an anchor, and implements the QTextCursor moves and edits used by the
+ * TextDocument API. Moves and edits are clamped to the document, like QTextCursor does.
+ * Backends without a view of their own call positionChanged and selectionChanged when the cursor changes.
+ */
+class DocumentBackend
+{
+public:
+    using MoveOperation = QTextCursor::MoveOperation;
+    using MoveMode = QTextCursor::MoveMode;
+
+    virtual ~DocumentBackend() = default;
+
+    virtual QString text() const = 0;
+    /**
+     * Returns the text between the positions, without reading the rest of the document.
+     * Unlike text() and the chunks, it's the text as stored: a QTextDocument keeps its non-breaking spaces and line
+     * separators, so the range can be edited back unchanged.
+     */
+    virtual QString text(qsizetype from, qsizetype to) const = 0;
+    /**
+     * Call the function with the contiguous parts of the text from the position, until it returns false.
+     */
+    using ChunkFunction = std::function<bool(qsizetype position, QStringView text)>;
+    virtual void forEachChunk(qsizetype from, const ChunkFunction &function) const = 0;
+    /**
+     * Replace the whole text, the cursor goes to the start of the document.
+     */
+    virtual void setText(const QString &text) = 0;
+    /**
+     * Replace the whole text with the content of a UTF-8 file, the cursor goes to the start of the document.
+     */
+    virtual bool open(const QString &fileName) = 0;
+    /**
+     * Write the text in UTF-8.
+     */
+    virtual bool save(QIODevice *device) const = 0;
+
+    virtual qsizetype position() const = 0;
+    virtual qsizetype anchor() const = 0;
+    bool hasSelection() const { return position() != anchor(); }
+    /**
+     * Returns the selected text, with '\n' as line separator.
+     */
+    virtual QString selectedText() const = 0;
+    virtual QString currentWord() const = 0;
+
+    virtual void movePosition(MoveOperation operation, MoveMode mode = QTextCursor::MoveAnchor, int count = 1) = 0;
+    virtual void setPosition(qsizetype position, MoveMode mode = QTextCursor::MoveAnchor) = 0;
+    virtual void selectAll() = 0;
+    virtual void clearSelection() = 0;
+
+    /**
+     * Insert the text at the cursor, replacing the selection.
+     */
+    virtual void insertText(const QString &text) = 0;
+    virtual void removeSelectedText() = 0;
+    /**
+     * Find the text after the cursor, case insensitive, and select it. Returns false if not found.
+     */
+    virtual bool find(const QString &text) = 0;
+
+    /**
+     * Edits between begin and commit are one undo step, and notified once on commit. Transactions aren't nested.
+     */
+    virtual void beginTransaction() = 0;
+    virtual void commitTransaction() = 0;
+
+    std::function<void()> positionChanged;
+    std::function<void()> selectionChanged;
+};
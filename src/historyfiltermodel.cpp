@@ -0,0 +1,169 @@
+#include "historyfiltermodel.h"
+
+#include <algorithm>
+
+HistoryFilterModel::HistoryFilterModel(HistoryModel *historyModel, QObject *parent)
+    : QAbstractProxyModel(parent)
+    , m_historyModel(historyModel)
+{
+    Q_ASSERT(historyModel);
+    setSourceModel(historyModel);
+
+    // Without a filter, the changes are forwarded as is
+    connect(historyModel, &QAbstractItemModel::rowsAboutToBeInserted, this,
+            [this](const QModelIndex &, int first, int last) {
+                if (!isFiltered())
+                    beginInsertRows({}, first, last);
+            });
+    connect(historyModel, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+        if (isFiltered())
+            onRowsInserted(first, last);
+        else
+            endInsertRows();
+    });
+    connect(historyModel, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) {
+                if (!isFiltered())
+                    beginRemoveRows({}, first, last);
+            });
+    connect(historyModel, &QAbstractItemModel::rowsRemoved, this, [this]() {
+        if (isFiltered())
+            onRowsRemoved();
+        else
+            endRemoveRows();
+    });
+    connect(historyModel, &QAbstractItemModel::dataChanged, this, &HistoryFilterModel::onDataChanged);
+    connect(historyModel, &QAbstractItemModel::modelAboutToBeReset, this, &HistoryFilterModel::beginResetModel);
+    connect(historyModel, &QAbstractItemModel::modelReset, this, [this]() {
+        updateRows();
+        endResetModel();
+    });
+}
+
+void HistoryFilterModel::setFilter(const HistoryModel::Filter &filter)
+{
+    m_filter = filter;
+    refresh();
+}
+
+void HistoryFilterModel::refresh()
+{
+    beginResetModel();
+    updateRows();
+    endResetModel();
+}
+
+void HistoryFilterModel::updateRows()
+{
+    m_rows.clear();
+    if (!isFiltered())
+        return;
+    const auto rows = m_historyModel->findRows(m_filter);
+    m_rows.reserve(rows.size());
+    for (const int row : rows)
+        m_rows.push_back(m_historyModel->evictedRows() + row);
+}
+
+QModelIndex HistoryFilterModel::index(int row, int column, const QModelIndex &parent) const
+{
+    return hasIndex(row, column, parent) ? createIndex(row, column) : QModelIndex();
+}
+
+QModelIndex HistoryFilterModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child)
+    return {};
+}
+
+int HistoryFilterModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return isFiltered() ? static_cast<int>(m_rows.size()) : m_historyModel->rowCount();
+}
+
+int HistoryFilterModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_historyModel->columnCount();
+}
+
+QModelIndex HistoryFilterModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid())
+        return {};
+    if (!isFiltered())
+        return m_historyModel->index(proxyIndex.row(), proxyIndex.column());
+    const auto row = static_cast<int>(m_rows[proxyIndex.row()] - m_historyModel->evictedRows());
+    return m_historyModel->index(row, proxyIndex.column());
+}
+
+QModelIndex HistoryFilterModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+        return {};
+    if (!isFiltered())
+        return index(sourceIndex.row(), sourceIndex.column());
+    const qint64 row = m_historyModel->evictedRows() + sourceIndex.row();
+    auto it = std::lower_bound(m_rows.cbegin(), m_rows.cend(), row);
+    if (it == m_rows.cend() || *it != row)
+        return {};
+    return index(static_cast<int>(it - m_rows.cbegin()), sourceIndex.column());
+}
+
+// Rows are always added at the end of the history
+void HistoryFilterModel::onRowsInserted(int first, int last)
+{
+    std::vector<qint64> rows;
+    for (int row = first; row <= last; ++row) {
+        if (m_historyModel->matches(row, m_filter))
+            rows.push_back(m_historyModel->evictedRows() + row);
+    }
+    if (rows.empty())
+        return;
+
+    const int count = static_cast<int>(m_rows.size());
+    beginInsertRows({}, count, count + static_cast<int>(rows.size()) - 1);
+    m_rows.insert(m_rows.end(), rows.cbegin(), rows.cend());
+    endInsertRows();
+}
+
+// Rows are always removed from the beginning of the history
+void HistoryFilterModel::onRowsRemoved()
+{
+    const auto removed = std::lower_bound(m_rows.begin(), m_rows.end(), m_historyModel->evictedRows());
+    if (removed == m_rows.begin())
+        return;
+
+    beginRemoveRows({}, 0, static_cast<int>(removed - m_rows.begin()) - 1);
+    m_rows.erase(m_rows.begin(), removed);
+    endRemoveRows();
+}
+
+void HistoryFilterModel::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!isFiltered()) {
+        emit dataChanged(mapFromSource(topLeft), mapFromSource(bottomRight));
+        return;
+    }
+
+    // A changed row may start or stop matching the filter
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const qint64 historyRow = m_historyModel->evictedRows() + row;
+        auto it = std::lower_bound(m_rows.begin(), m_rows.end(), historyRow);
+        const int proxyRow = static_cast<int>(it - m_rows.begin());
+        const bool isShown = it != m_rows.end() && *it == historyRow;
+        const bool isMatching = m_historyModel->matches(row, m_filter);
+
+        if (isShown && isMatching) {
+            emit dataChanged(index(proxyRow, topLeft.column()), index(proxyRow, bottomRight.column()));
+        } else if (isShown) {
+            beginRemoveRows({}, proxyRow, proxyRow);
+            m_rows.erase(it);
+            endRemoveRows();
+        } else if (isMatching) {
+            beginInsertRows({}, proxyRow, proxyRow);
+            m_rows.insert(it, historyRow);
+            endInsertRows();
+        }
+    }
+}
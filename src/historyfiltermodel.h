@@ -0,0 +1,45 @@
+#pragma once
+
+#include "historymodel.h"
+
+#include <QAbstractProxyModel>
+#include <QPointer>
+
+/**
+ * @brief The HistoryFilterModel class shows the rows of the history matching a filter
+ *
+ * Unlike a QSortFilterProxyModel, the rows are found using the HistoryModel index, and new rows are checked one by
+ * one when they are added. With an empty filter, all rows are shown without any mapping.
+ */
+class HistoryFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryFilterModel(HistoryModel *historyModel, QObject *parent = nullptr);
+
+    void setFilter(const HistoryModel::Filter &filter);
+    const HistoryModel::Filter &filter() const { return m_filter; }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = {}) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+
+private:
+    bool isFiltered() const { return !m_filter.isEmpty(); }
+    void refresh();
+    void updateRows();
+
+    void onRowsInserted(int first, int last);
+    void onRowsRemoved();
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+    QPointer<HistoryModel> m_historyModel;
+    HistoryModel::Filter m_filter;
+    // Rows matching the filter, by position in the whole history
+    std::vector<qint64> m_rows;
+};
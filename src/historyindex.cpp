@@ -0,0 +1,103 @@
+#include "historyindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr int TrigramSize = 3;
+
+quint64 trigram(QStringView text, qsizetype position)
+{
+    quint64 key = 0;
+    for (qsizetype i = position; i < position + TrigramSize; ++i)
+        key = (key << 16) | text.at(i).toCaseFolded().unicode();
+    return key;
+}
+
+} // namespace
+
+void HistoryIndex::addToList(PostingList &list, qint64 row)
+{
+    // A row is added once, even if it's indexed again or if a trigram appears more than once
+    if (list.empty() || list.back() != row)
+        list.push_back(row);
+}
+
+void HistoryIndex::addRow(qint64 row, ApiId apiId, const QStringList &texts)
+{
+    Q_ASSERT(row >= m_nextRow - 1);
+
+    addToList(m_apiRows[apiId], row);
+    for (const auto &text : texts) {
+        for (qsizetype i = 0; i + TrigramSize <= text.size(); ++i)
+            addToList(m_trigramRows[trigram(text, i)], row);
+    }
+    m_nextRow = std::max(m_nextRow, row + 1);
+}
+
+void HistoryIndex::removeBefore(qint64 row)
+{
+    m_firstRow = std::max(m_firstRow, row);
+    m_nextRow = std::max(m_nextRow, m_firstRow);
+    if (m_firstRow - m_prunedRow > m_nextRow - m_firstRow)
+        prune();
+}
+
+void HistoryIndex::prune()
+{
+    auto pruneList = [this](PostingList &list) {
+        list.erase(list.begin(), std::lower_bound(list.begin(), list.end(), m_firstRow));
+    };
+    for (auto it = m_apiRows.begin(); it != m_apiRows.end();) {
+        pruneList(it.value());
+        it = it.value().empty() ? m_apiRows.erase(it) : std::next(it);
+    }
+    for (auto it = m_trigramRows.begin(); it != m_trigramRows.end();) {
+        pruneList(it.value());
+        it = it.value().empty() ? m_trigramRows.erase(it) : std::next(it);
+    }
+    m_prunedRow = m_firstRow;
+}
+
+std::optional<std::vector<qint64>> HistoryIndex::candidates(const QList<ApiId> &apis, const QString &text) const
+{
+    static const PostingList empty;
+    std::vector<const PostingList *> lists;
+
+    // Rows of any of the APIs
+    PostingList apiRows;
+    if (!apis.isEmpty()) {
+        for (const auto apiId : apis) {
+            auto it = m_apiRows.constFind(apiId);
+            if (it == m_apiRows.cend())
+                continue;
+            PostingList merged;
+            merged.reserve(apiRows.size() + it->size());
+            std::merge(apiRows.cbegin(), apiRows.cend(), it->cbegin(), it->cend(), std::back_inserter(merged));
+            apiRows = std::move(merged);
+        }
+        lists.push_back(&apiRows);
+    }
+
+    // Rows with all the trigrams of the text
+    for (qsizetype i = 0; i + TrigramSize <= text.size(); ++i) {
+        auto it = m_trigramRows.constFind(trigram(text, i));
+        lists.push_back(it == m_trigramRows.cend() ? &empty : &it.value());
+    }
+
+    if (lists.empty())
+        return std::nullopt;
+
+    // Intersect, starting with the shortest lists
+    std::sort(lists.begin(), lists.end(), [](auto *left, auto *right) { return left->size() < right->size(); });
+    PostingList rows(std::lower_bound(lists.front()->cbegin(), lists.front()->cend(), m_firstRow),
+                     lists.front()->cend());
+    for (size_t i = 1; i < lists.size() && !rows.empty(); ++i) {
+        PostingList intersection;
+        std::set_intersection(rows.cbegin(), rows.cend(), lists[i]->cbegin(), lists[i]->cend(),
+                              std::back_inserter(intersection));
+        rows = std::move(intersection);
+    }
+    return rows;
+}
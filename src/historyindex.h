@@ -0,0 +1,83 @@
+#pragma once
+
+#include "apiregistry.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QVariant>
+
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The HistoryIndex class indexes the rows of the history, to search them without scanning all rows
+ *
+ * Rows are identified by their position in the whole history, including the rows already removed, so they don't
+ * change when the oldest rows are removed. The index keeps a posting list (sorted list of rows) per API, and per
+ * trigram of the parameters text. Trigrams are case folded.
+ * A search returns candidate rows: they may not contain the text (the trigrams are not checked for adjacency, and
+ * merged rows keep their previous trigrams), so the rows need to be checked, but no other row can match.
+ */
+class HistoryIndex
+{
+public:
+    void clear() { *this = HistoryIndex(); }
+
+    /**
+     * Index a row, rows are added in increasing order. Adding the last row again updates it, after a merge.
+     */
+    void addRow(qint64 row, ApiId apiId, const QStringList &texts);
+    /**
+     * The last row indexed changed after a merge, it's indexed again with the next row added.
+     */
+    void reindexLast()
+    {
+        if (m_nextRow > m_firstRow)
+            --m_nextRow;
+    }
+    /**
+     * Rows before row are removed from the history.
+     */
+    void removeBefore(qint64 row);
+
+    // Next row to index
+    qint64 nextRow() const { return m_nextRow; }
+    // APIs with at least one row indexed
+    QList<ApiId> apis() const { return m_apiRows.keys(); }
+
+    /**
+     * Returns the rows calling one of the APIs (or any API if empty), which may contain the text in a parameter.
+     * Returns no value if all rows are candidates.
+     */
+    std::optional<std::vector<qint64>> candidates(const QList<ApiId> &apis, const QString &text) const;
+
+    /**
+     * Text of the parameters of a row, as indexed and searched.
+     */
+    template <typename Rows>
+    static QStringList texts(const Rows &rows, int row)
+    {
+        QStringList texts;
+        for (int i = 0; i < rows.argCount(row); ++i) {
+            const QVariant value = rows.argValue(row, i);
+            if (value.typeId() == QMetaType::QStringList)
+                texts += value.toStringList();
+            else
+                texts.push_back(value.toString());
+        }
+        return texts;
+    }
+
+private:
+    using PostingList = std::vector<qint64>;
+
+    static void addToList(PostingList &list, qint64 row);
+    void prune();
+
+    QHash<ApiId, PostingList> m_apiRows;
+    QHash<quint64, PostingList> m_trigramRows;
+    qint64 m_firstRow = 0;
+    qint64 m_nextRow = 0;
+    // Removed rows are erased from the lists when there are more than rows left
+    qint64 m_prunedRow = 0;
+};
@@ -0,0 +1,742 @@
+#include "historyjournal.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char JournalMagic[8] = {'Q', 'T', 'W', 'S', 'J', 'R', 'N', '1'};
+constexpr char IndexMagic[8] = {'Q', 'T', 'W', 'S', 'I', 'D', 'X', '2'};
+constexpr qint64 JournalHeaderSize = 16;
+// Magic, API count, API capacity, removed rows, then one offset per API definition
+constexpr qint64 indexHeaderSize(quint32 apiCapacity)
+{
+    return 24 + static_cast<qint64>(apiCapacity) * 8;
+}
+// Size + type before the payload, checksum after
+constexpr qint64 RecordOverhead = 4 + 1 + 4;
+
+enum ValueTag : quint8 { InvalidValue, BuiltinValue, StringValue, StringListValue, EnumValue, StreamedValue };
+enum RowFlag : quint8 { NoRowFlag = 0x0, RowHasReturn = 0x1 };
+
+quint32 checksum(const uchar *data, qsizetype size)
+{
+    // FNV-1a
+    quint32 hash = 2166136261u;
+    for (qsizetype i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+void put(QByteArray &out, T value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void putString(QByteArray &out, QStringView text)
+{
+    put<quint32>(out, static_cast<quint32>(text.size()));
+    if constexpr (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        out.append(reinterpret_cast<const char *>(text.utf16()), text.size() * 2);
+    } else {
+        for (QChar c : text)
+            put<quint16>(out, c.unicode());
+    }
+}
+
+bool isBuiltinInline(QMetaType metaType)
+{
+    switch (static_cast<QMetaType::Type>(metaType.id())) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+    case QMetaType::QChar:
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+qint64 enumValue(const QVariant &value)
+{
+    switch (value.metaType().sizeOf()) {
+    case 1:
+        return *static_cast<const qint8 *>(value.constData());
+    case 2:
+        return *static_cast<const qint16 *>(value.constData());
+    case 4:
+        return *static_cast<const qint32 *>(value.constData());
+    default:
+        return *static_cast<const qint64 *>(value.constData());
+    }
+}
+
+QVariant enumVariant(const QByteArray &typeName, qint64 value)
+{
+    const QMetaType metaType = QMetaType::fromName(typeName);
+    if (!metaType.isValid() || !metaType.flags().testAnyFlag(QMetaType::IsEnumeration))
+        return QVariant(static_cast<qlonglong>(value));
+
+    QVariant variant(metaType);
+    switch (metaType.sizeOf()) {
+    case 1:
+        *static_cast<qint8 *>(variant.data()) = static_cast<qint8>(value);
+        break;
+    case 2:
+        *static_cast<qint16 *>(variant.data()) = static_cast<qint16>(value);
+        break;
+    case 4:
+        *static_cast<qint32 *>(variant.data()) = static_cast<qint32>(value);
+        break;
+    default:
+        *static_cast<qint64 *>(variant.data()) = value;
+        break;
+    }
+    return variant;
+}
+
+void putValue(QByteArray &out, const QVariant &value)
+{
+    const QMetaType metaType = value.metaType();
+    if (!value.isValid()) {
+        put<quint8>(out, InvalidValue);
+    } else if (metaType.flags().testAnyFlag(QMetaType::IsEnumeration)) {
+        put<quint8>(out, EnumValue);
+        const QByteArray typeName(metaType.name());
+        put<quint32>(out, static_cast<quint32>(typeName.size()));
+        out.append(typeName);
+        put<qint64>(out, enumValue(value));
+    } else if (isBuiltinInline(metaType)) {
+        put<quint8>(out, BuiltinValue);
+        put<quint32>(out, static_cast<quint32>(metaType.id()));
+        quint64 payload = 0;
+        std::memcpy(&payload, value.constData(), metaType.sizeOf());
+        put<quint64>(out, payload);
+    } else if (metaType.id() == QMetaType::QString) {
+        put<quint8>(out, StringValue);
+        putString(out, value.toString());
+    } else if (metaType.id() == QMetaType::QStringList) {
+        put<quint8>(out, StringListValue);
+        const QStringList list = value.toStringList();
+        put<quint32>(out, static_cast<quint32>(list.size()));
+        for (const auto &text : list)
+            putString(out, text);
+    } else {
+        put<quint8>(out, StreamedValue);
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << value;
+        put<quint32>(out, static_cast<quint32>(data.size()));
+        out.append(data);
+    }
+}
+
+/**
+ * Bound-checked reading of a record payload
+ */
+struct Input
+{
+    const uchar *data;
+    const uchar *end;
+    bool ok = true;
+
+    bool has(qint64 size)
+    {
+        ok = ok && end - data >= size;
+        return ok;
+    }
+
+    template <typename T>
+    T get()
+    {
+        if (!has(sizeof(T)))
+            return T();
+        const T value = qFromLittleEndian<T>(data);
+        data += sizeof(T);
+        return value;
+    }
+
+    QByteArray getBytes()
+    {
+        const auto size = get<quint32>();
+        if (!has(size))
+            return {};
+        QByteArray bytes(reinterpret_cast<const char *>(data), size);
+        data += size;
+        return bytes;
+    }
+
+    QString getString()
+    {
+        const auto size = get<quint32>();
+        if (!has(static_cast<qint64>(size) * 2))
+            return {};
+        QString text(size, Qt::Uninitialized);
+        if constexpr (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+            std::memcpy(text.data(), data, size * 2);
+        } else {
+            for (quint32 i = 0; i < size; ++i)
+                text[i] = QChar(qFromLittleEndian<quint16>(data + i * 2));
+        }
+        data += size * 2;
+        return text;
+    }
+
+    QVariant getValue()
+    {
+        switch (get<quint8>()) {
+        case InvalidValue:
+            return {};
+        case BuiltinValue: {
+            const QMetaType metaType(static_cast<int>(get<quint32>()));
+            const auto payload = get<quint64>();
+            return QVariant(metaType, &payload);
+        }
+        case StringValue:
+            return getString();
+        case StringListValue: {
+            QStringList list;
+            const auto count = get<quint32>();
+            for (quint32 i = 0; i < count && ok; ++i)
+                list.push_back(getString());
+            return list;
+        }
+        case EnumValue: {
+            const QByteArray typeName = getBytes();
+            return enumVariant(typeName, get<qint64>());
+        }
+        case StreamedValue: {
+            const QByteArray bytes = getBytes();
+            QDataStream stream(bytes);
+            QVariant value;
+            stream >> value;
+            return value;
+        }
+        }
+        ok = false;
+        return {};
+    }
+};
+
+} // namespace
+
+QString Journal::indexFileName(const QString &fileName)
+{
+    return fileName + ".idx";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JournalReader
+///////////////////////////////////////////////////////////////////////////////
+JournalReader::~JournalReader()
+{
+    close();
+}
+
+bool JournalReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_size = m_file.size();
+    if (m_size < JournalHeaderSize) {
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data || std::memcmp(m_data, JournalMagic, sizeof(JournalMagic)) != 0) {
+        close();
+        return false;
+    }
+
+    const bool indexValid = loadIndex(Journal::indexFileName(fileName));
+    if (!indexValid) {
+        m_rowOffsets.clear();
+        m_apiOffsets.clear();
+        m_apis.clear();
+        m_apiCapacity = Journal::InitialApiCapacity;
+        m_removedRows = 0;
+        m_validSize = JournalHeaderSize;
+    }
+    // Read the records not in the index yet, the index is still complete if they only repeat the removed rows count
+    m_indexComplete = indexValid;
+    const qint64 indexedRemovedRows = m_removedRows;
+    scan(m_validSize);
+    m_indexComplete = m_indexComplete && m_removedRows == indexedRemovedRows;
+    return true;
+}
+
+void JournalReader::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+    m_file.close();
+    m_size = 0;
+    m_validSize = 0;
+    m_indexComplete = false;
+    m_apiCapacity = Journal::InitialApiCapacity;
+    m_removedRows = 0;
+    m_rowOffsets.clear();
+    m_apiOffsets.clear();
+    m_apis.clear();
+    m_cachedRow = -1;
+}
+
+bool JournalReader::readRecord(qint64 offset, Journal::RecordType *type, const uchar **payload,
+                               quint32 *payloadSize) const
+{
+    if (offset < JournalHeaderSize || m_size - offset < RecordOverhead)
+        return false;
+    const uchar *record = m_data + offset;
+    const auto size = qFromLittleEndian<quint32>(record);
+    if (m_size - offset - RecordOverhead < size)
+        return false;
+    if (checksum(record + 4, size + 1) != qFromLittleEndian<quint32>(record + 5 + size))
+        return false;
+
+    *type = static_cast<Journal::RecordType>(record[4]);
+    *payload = record + 5;
+    *payloadSize = size;
+    return true;
+}
+
+void JournalReader::addApi(qint64 offset, const uchar *payload, quint32 payloadSize)
+{
+    Input input {payload, payload + payloadSize};
+    const auto journalId = input.get<quint32>();
+    const QString name = input.getString();
+    if (!input.ok)
+        return;
+    m_apis.insert(journalId, ApiRegistry::registerApi(name));
+    m_apiOffsets.push_back(offset);
+}
+
+void JournalReader::scan(qint64 offset)
+{
+    Journal::RecordType type;
+    const uchar *payload;
+    quint32 payloadSize;
+    while (readRecord(offset, &type, &payload, &payloadSize)) {
+        switch (type) {
+        case Journal::DefineApi:
+            addApi(offset, payload, payloadSize);
+            break;
+        case Journal::Row:
+            m_rowOffsets.push_back(offset);
+            break;
+        case Journal::ReplaceLastRow:
+            if (m_rowOffsets.empty())
+                return;
+            m_rowOffsets.back() = offset;
+            break;
+        case Journal::RemoveFirstRows: {
+            Input input {payload, payload + payloadSize};
+            const auto removedRows = input.get<qint64>();
+            if (!input.ok)
+                return;
+            m_removedRows = removedRows;
+            break;
+        }
+        default:
+            return;
+        }
+        if (type != Journal::RemoveFirstRows)
+            m_indexComplete = false;
+        offset += RecordOverhead + payloadSize;
+        m_validSize = offset;
+    }
+}
+
+bool JournalReader::loadIndex(const QString &indexFileName)
+{
+    QFile indexFile(indexFileName);
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return false;
+    const qint64 indexSize = indexFile.size();
+    if (indexSize < indexHeaderSize(Journal::InitialApiCapacity))
+        return false;
+    const uchar *index = indexFile.map(0, indexSize);
+    if (!index || std::memcmp(index, IndexMagic, sizeof(IndexMagic)) != 0)
+        return false;
+
+    m_apiCapacity = qFromLittleEndian<quint32>(index + 12);
+    const qint64 headerSize = indexHeaderSize(m_apiCapacity);
+    if (m_apiCapacity < Journal::InitialApiCapacity || indexSize < headerSize || (indexSize - headerSize) % 8 != 0)
+        return false;
+    m_removedRows = qFromLittleEndian<qint64>(index + 16);
+
+    Journal::RecordType type;
+    const uchar *payload;
+    quint32 payloadSize;
+    qint64 lastOffset = -1;
+
+    const auto apiCount = qFromLittleEndian<quint32>(index + 8);
+    if (apiCount > m_apiCapacity)
+        return false;
+    for (quint32 i = 0; i < apiCount; ++i) {
+        const auto offset = qFromLittleEndian<qint64>(index + 24 + i * 8);
+        if (!readRecord(offset, &type, &payload, &payloadSize) || type != Journal::DefineApi)
+            return false;
+        addApi(offset, payload, payloadSize);
+        lastOffset = std::max(lastOffset, offset);
+    }
+
+    const qint64 rowCount = (indexSize - headerSize) / 8;
+    m_rowOffsets.resize(rowCount);
+    for (qint64 row = 0; row < rowCount; ++row)
+        m_rowOffsets[row] = qFromLittleEndian<qint64>(index + headerSize + row * 8);
+
+    // Only the last row is checked, the index is written after the journal
+    if (rowCount > 0) {
+        const qint64 offset = m_rowOffsets.back();
+        if (!readRecord(offset, &type, &payload, &payloadSize)
+            || (type != Journal::Row && type != Journal::ReplaceLastRow))
+            return false;
+        lastOffset = std::max(lastOffset, offset);
+    }
+
+    if (lastOffset == -1) {
+        m_validSize = JournalHeaderSize;
+    } else {
+        readRecord(lastOffset, &type, &payload, &payloadSize);
+        m_validSize = lastOffset + RecordOverhead + payloadSize;
+    }
+    return true;
+}
+
+qsizetype JournalReader::recordSize(int row) const
+{
+    Journal::RecordType type;
+    const uchar *payload;
+    quint32 payloadSize;
+    if (!readRecord(m_rowOffsets[row], &type, &payload, &payloadSize))
+        return 0;
+    return payloadSize;
+}
+
+const HistoryStore::Record &JournalReader::decode(int row) const
+{
+    if (m_cachedRow == row)
+        return m_cachedRecord;
+
+    m_cachedRow = row;
+    m_cachedRecord = {};
+
+    Journal::RecordType type;
+    const uchar *payload;
+    quint32 payloadSize;
+    if (!readRecord(m_rowOffsets[row], &type, &payload, &payloadSize))
+        return m_cachedRecord;
+
+    Input input {payload, payload + payloadSize};
+    m_cachedRecord.apiId = m_apis.value(input.get<quint32>(), ApiRegistry::InvalidApi);
+    const auto flags = input.get<quint8>();
+    const auto count = input.get<quint16>();
+    const int paramCount = (flags & RowHasReturn) ? count - 1 : count;
+    for (int i = 0; i < paramCount && input.ok; ++i) {
+        QString name = input.getString();
+        m_cachedRecord.params.push_back({std::move(name), input.getValue()});
+    }
+    if (flags & RowHasReturn) {
+        QString name = input.getString();
+        m_cachedRecord.returnArg = {std::move(name), input.getValue()};
+    }
+    return m_cachedRecord;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JournalWriter
+///////////////////////////////////////////////////////////////////////////////
+JournalWriter::~JournalWriter()
+{
+    close();
+}
+
+bool JournalWriter::open(const QString &fileName)
+{
+    close();
+
+    std::vector<qint64> rowOffsets;
+    bool rewriteIndex = true;
+    qint64 validSize = 0;
+    if (QFileInfo::exists(fileName)) {
+        JournalReader reader;
+        if (!reader.open(fileName))
+            return false;
+        validSize = reader.validSize();
+        rewriteIndex = !reader.isIndexComplete();
+        m_apiCapacity = reader.apiCapacity();
+        m_removedRows = reader.removedRows();
+        rowOffsets.reserve(reader.size());
+        for (int row = 0; row < reader.size(); ++row)
+            rowOffsets.push_back(reader.rowOffset(row));
+        m_apiOffsets = reader.apiOffsets();
+        for (auto it = reader.apis().cbegin(); it != reader.apis().cend(); ++it)
+            m_apis.insert(it.value(), it.key());
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite))
+        return false;
+    if (validSize == 0) {
+        m_file.resize(0);
+        QByteArray header(JournalMagic, sizeof(JournalMagic));
+        header.append(JournalHeaderSize - header.size(), '\0');
+        m_file.write(header);
+        m_fileSize = JournalHeaderSize;
+    } else {
+        // Remove any partially written record
+        m_file.resize(validSize);
+        m_fileSize = validSize;
+    }
+    m_file.seek(m_fileSize);
+    if (!rowOffsets.empty())
+        m_lastRowOffset = rowOffsets.back();
+
+    m_indexFile.setFileName(Journal::indexFileName(fileName));
+    if (!m_indexFile.open(QIODevice::ReadWrite)) {
+        m_file.close();
+        return false;
+    }
+    if (rewriteIndex) {
+        m_indexFile.resize(0);
+        while (m_apiCapacity < m_apiOffsets.size())
+            m_apiCapacity = m_apiCapacity * 2 + 3;
+        writeIndexHeader();
+        QByteArray offsets;
+        offsets.reserve(rowOffsets.size() * 8);
+        for (const auto offset : rowOffsets)
+            put<qint64>(offsets, offset);
+        m_indexFile.seek(indexHeaderSize(m_apiCapacity));
+        m_indexFile.write(offsets);
+    }
+    m_indexSize = indexHeaderSize(m_apiCapacity) + static_cast<qint64>(rowOffsets.size()) * 8;
+    m_indexFile.seek(m_indexSize);
+    return true;
+}
+
+void JournalWriter::close()
+{
+    if (!isOpen())
+        return;
+    flush();
+    m_file.close();
+    m_indexFile.close();
+    m_fileSize = 0;
+    m_indexSize = 0;
+    m_apis.clear();
+    m_apiOffsets.clear();
+    m_apiCapacity = Journal::InitialApiCapacity;
+    m_removedRows = 0;
+    m_lastRowOffset = -1;
+}
+
+void JournalWriter::clear()
+{
+    if (!isOpen())
+        return;
+
+    m_buffer.resize(0);
+    m_indexBuffer.resize(0);
+    m_pendingRow.resize(0);
+    m_apis.clear();
+    m_apiOffsets.clear();
+    m_removedRows = 0;
+    m_lastRowOffset = -1;
+
+    m_file.resize(JournalHeaderSize);
+    m_fileSize = JournalHeaderSize;
+    m_file.seek(m_fileSize);
+
+    m_indexFile.resize(0);
+    writeIndexHeader();
+    m_indexSize = indexHeaderSize(m_apiCapacity);
+    m_indexFile.seek(m_indexSize);
+}
+
+void JournalWriter::writeIndexHeader()
+{
+    Q_ASSERT(m_apiOffsets.size() <= m_apiCapacity);
+    QByteArray header(IndexMagic, sizeof(IndexMagic));
+    put<quint32>(header, static_cast<quint32>(m_apiOffsets.size()));
+    put<quint32>(header, m_apiCapacity);
+    put<qint64>(header, m_removedRows);
+    for (const auto offset : m_apiOffsets)
+        put<qint64>(header, offset);
+    header.append(indexHeaderSize(m_apiCapacity) - header.size(), '\0');
+
+    m_indexFile.seek(0);
+    m_indexFile.write(header);
+    m_indexHeaderChanged = false;
+}
+
+/**
+ * Grow the API table of the index, moving the row offsets after it.
+ * The index is truncated first: if the relocation is interrupted, the reader rebuilds it from the journal.
+ */
+void JournalWriter::relocateIndexRows()
+{
+    m_indexFile.flush();
+    m_indexFile.seek(indexHeaderSize(m_apiCapacity));
+    const QByteArray rows = m_indexFile.read(m_indexSize - indexHeaderSize(m_apiCapacity));
+
+    // Keep the header a multiple of 4K
+    while (m_apiCapacity < m_apiOffsets.size())
+        m_apiCapacity = m_apiCapacity * 2 + 3;
+
+    m_indexFile.resize(0);
+    writeIndexHeader();
+    m_indexFile.write(rows);
+    m_indexSize = indexHeaderSize(m_apiCapacity) + rows.size();
+}
+
+quint32 JournalWriter::journalApiId(ApiId apiId)
+{
+    auto it = m_apis.constFind(apiId);
+    if (it != m_apis.cend())
+        return it.value();
+
+    const auto journalId = static_cast<quint32>(m_apis.size());
+    QByteArray payload;
+    put<quint32>(payload, journalId);
+    putString(payload, ApiRegistry::info(apiId).name);
+    m_apiOffsets.push_back(writeRecord(Journal::DefineApi, payload));
+    m_apis.insert(apiId, journalId);
+    m_indexHeaderChanged = true;
+    return journalId;
+}
+
+qint64 JournalWriter::writeRecord(Journal::RecordType type, const QByteArray &payload)
+{
+    const qint64 offset = m_fileSize + m_buffer.size();
+    const qsizetype start = m_buffer.size();
+    put<quint32>(m_buffer, static_cast<quint32>(payload.size()));
+    put<quint8>(m_buffer, type);
+    m_buffer.append(payload);
+    put<quint32>(m_buffer,
+                 checksum(reinterpret_cast<const uchar *>(m_buffer.constData()) + start + 4, payload.size() + 1));
+
+    if (m_buffer.size() >= BufferSize)
+        writeBuffers();
+    return offset;
+}
+
+static QByteArray rowPayload(quint32 journalApiId, const HistoryStore::Record &record)
+{
+    QByteArray payload;
+    put<quint32>(payload, journalApiId);
+    const bool hasReturn = !record.returnArg.isEmpty();
+    put<quint8>(payload, hasReturn ? RowHasReturn : NoRowFlag);
+    put<quint16>(payload, static_cast<quint16>(record.params.size() + (hasReturn ? 1 : 0)));
+    for (const auto &param : record.params) {
+        putString(payload, param.name);
+        putValue(payload, param.value);
+    }
+    if (hasReturn) {
+        putString(payload, record.returnArg.name);
+        putValue(payload, record.returnArg.value);
+    }
+    return payload;
+}
+
+void JournalWriter::appendRow(const HistoryStore::Record &record)
+{
+    Q_ASSERT(isOpen());
+    writePendingRow();
+    const quint32 apiId = journalApiId(record.apiId);
+    m_pendingRow = rowPayload(apiId, record);
+    m_pendingRowType = Journal::Row;
+}
+
+void JournalWriter::replaceLastRow(const HistoryStore::Record &record)
+{
+    Q_ASSERT(isOpen() && (m_lastRowOffset != -1 || !m_pendingRow.isEmpty()));
+    const quint32 apiId = journalApiId(record.apiId);
+    // A row not written yet is simply replaced, so successive merges only write the last state
+    if (m_pendingRow.isEmpty())
+        m_pendingRowType = Journal::ReplaceLastRow;
+    m_pendingRow = rowPayload(apiId, record);
+}
+
+void JournalWriter::writePendingRow()
+{
+    if (m_pendingRow.isEmpty())
+        return;
+
+    m_lastRowOffset = writeRecord(m_pendingRowType, m_pendingRow);
+    m_pendingRow.resize(0);
+    if (m_pendingRowType == Journal::ReplaceLastRow) {
+        // Update the index entry of the last row, which is either still in the buffer or already written
+        if (!m_indexBuffer.isEmpty()) {
+            m_indexBuffer.chop(8);
+        } else {
+            m_indexFile.flush();
+            m_indexSize -= 8;
+            m_indexFile.seek(m_indexSize);
+        }
+    }
+    put<qint64>(m_indexBuffer, m_lastRowOffset);
+}
+
+void JournalWriter::removeFirstRows(int count)
+{
+    Q_ASSERT(isOpen());
+    // The total is written, so only the last record matters
+    m_removedRows += count;
+    QByteArray payload;
+    put<qint64>(payload, m_removedRows);
+    writeRecord(Journal::RemoveFirstRows, payload);
+    m_indexHeaderChanged = true;
+}
+
+void JournalWriter::flush()
+{
+    if (!isOpen())
+        return;
+    writePendingRow();
+    writeBuffers();
+}
+
+void JournalWriter::writeBuffers()
+{
+    // The journal is written before the index, so the index never points to missing data
+    if (!m_buffer.isEmpty()) {
+        m_file.write(m_buffer);
+        m_fileSize += m_buffer.size();
+        m_buffer.resize(0);
+        m_file.flush();
+    }
+    if (m_apiOffsets.size() > m_apiCapacity) {
+        relocateIndexRows();
+    } else if (m_indexHeaderChanged) {
+        writeIndexHeader();
+        m_indexFile.seek(m_indexSize);
+    }
+    if (!m_indexBuffer.isEmpty()) {
+        m_indexFile.write(m_indexBuffer);
+        m_indexSize += m_indexBuffer.size();
+        m_indexBuffer.resize(0);
+    }
+    m_indexFile.flush();
+}
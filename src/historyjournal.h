@@ -0,0 +1,161 @@
+#pragma once
+
+#include "historystore.h"
+
+#include <QFile>
+#include <QHash>
+
+#include <vector>
+
+/**
+ * The history journal is an append-only binary file mirroring the history model, so a recording session survives a
+ * restart or a crash.
+ *
+ * The journal file starts with a header, followed by records: [quint32 size][quint8 type][payload][quint32 checksum].
+ * An API is defined once per journal, and rows refer to it by its journal id. A merge into the last row is written as
+ * a new record replacing the previous one; merges are coalesced in memory until the next flush.
+ * A side index file (journal name + ".idx") keeps the offset of the API definitions and of each row, so a journal can
+ * be reopened without reading all its records. Only the records written after the last indexed one are checked.
+ * The API table of the index has a fixed capacity, stored in its header; the rows are relocated when it grows.
+ * Rows removed from the start of the history are not removed from the journal, the number of rows removed is written
+ * in a record and in the index header instead.
+ */
+namespace Journal {
+enum RecordType : quint8 { DefineApi = 1, Row = 2, ReplaceLastRow = 3, RemoveFirstRows = 4 };
+
+// The index header (24 bytes + 8 per API) then fills a 4K page
+constexpr quint32 InitialApiCapacity = 509;
+QString indexFileName(const QString &fileName);
+}
+
+/**
+ * @brief The JournalReader class gives access to the rows of a journal, using a memory-mapped file
+ *
+ * Rows are decoded on demand, with the same accessors as the HistoryStore.
+ */
+class JournalReader
+{
+public:
+    JournalReader() = default;
+    ~JournalReader();
+
+    /**
+     * Map the journal and its index. If the index is missing or invalid, the rows are found by reading all records.
+     * Records after the last valid one (partially written during a crash) are ignored.
+     */
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    int size() const { return static_cast<int>(m_rowOffsets.size()); }
+    /**
+     * Number of rows removed from the start of the history, they are still in the journal.
+     */
+    qint64 removedRows() const { return m_removedRows; }
+
+    ApiId apiId(int row) const { return decode(row).apiId; }
+    int argCount(int row) const { return static_cast<int>(decode(row).params.size()); }
+    QString argName(int row, int arg) const { return decode(row).params.at(arg).name; }
+    QVariant argValue(int row, int arg) const { return decode(row).params.at(arg).value; }
+    bool hasReturn(int row) const { return !decode(row).returnArg.isEmpty(); }
+    QString returnName(int row) const { return decode(row).returnArg.name; }
+    QVariant returnValue(int row) const { return decode(row).returnArg.value; }
+
+    HistoryStore::Record record(int row) const { return decode(row); }
+    /**
+     * Size of the row record in the journal, in bytes
+     */
+    qsizetype recordSize(int row) const;
+
+    // Recovery information, used to continue writing an existing journal
+    qint64 validSize() const { return m_validSize; }
+    // False if the index had to be rebuilt or completed
+    bool isIndexComplete() const { return m_indexComplete; }
+    qint64 rowOffset(int row) const { return m_rowOffsets[row]; }
+    const std::vector<qint64> &apiOffsets() const { return m_apiOffsets; }
+    quint32 apiCapacity() const { return m_apiCapacity; }
+    const QHash<quint32, ApiId> &apis() const { return m_apis; }
+
+private:
+    bool readRecord(qint64 offset, Journal::RecordType *type, const uchar **payload, quint32 *payloadSize) const;
+    void scan(qint64 offset);
+    void addApi(qint64 offset, const uchar *payload, quint32 payloadSize);
+    bool loadIndex(const QString &indexFileName);
+    const HistoryStore::Record &decode(int row) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_validSize = 0;
+    bool m_indexComplete = false;
+    quint32 m_apiCapacity = Journal::InitialApiCapacity;
+    qint64 m_removedRows = 0;
+
+    std::vector<qint64> m_rowOffsets;
+    std::vector<qint64> m_apiOffsets;
+    QHash<quint32, ApiId> m_apis;
+
+    mutable int m_cachedRow = -1;
+    mutable HistoryStore::Record m_cachedRecord;
+};
+
+/**
+ * @brief The JournalWriter class appends rows to a journal
+ *
+ * Records are accumulated in memory and written sequentially when the buffer is full or on flush.
+ */
+class JournalWriter
+{
+public:
+    JournalWriter() = default;
+    ~JournalWriter();
+
+    /**
+     * Open a journal for writing. An existing journal is continued: a partially written record at the end is removed,
+     * and the index is rebuilt if needed.
+     */
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    /**
+     * Remove all rows from the journal.
+     */
+    void clear();
+
+    void appendRow(const HistoryStore::Record &record);
+    void replaceLastRow(const HistoryStore::Record &record);
+    /**
+     * Mark the count first rows as removed, they are skipped when the journal is restored.
+     */
+    void removeFirstRows(int count);
+    void flush();
+
+private:
+    quint32 journalApiId(ApiId apiId);
+    qint64 writeRecord(Journal::RecordType type, const QByteArray &payload);
+    void writePendingRow();
+    void writeBuffers();
+    void writeIndexHeader();
+    void relocateIndexRows();
+
+    static constexpr qsizetype BufferSize = 64 * 1024;
+
+    QFile m_file;
+    QFile m_indexFile;
+    QByteArray m_buffer;
+    QByteArray m_indexBuffer;
+    qint64 m_fileSize = 0;
+    qint64 m_indexSize = 0;
+
+    QHash<ApiId, quint32> m_apis;
+    std::vector<qint64> m_apiOffsets;
+    quint32 m_apiCapacity = Journal::InitialApiCapacity;
+    qint64 m_removedRows = 0;
+    qint64 m_lastRowOffset = -1;
+    bool m_indexHeaderChanged = false;
+
+    // Last row, not written yet as it can still be merged
+    QByteArray m_pendingRow;
+    Journal::RecordType m_pendingRowType = Journal::Row;
+};
@@ -1,21 +1,36 @@
 #include "historymodel.h"
+#include "chunkedwriter.h"
 #include "logger.h"
+#include "scriptcompressor.h"
+#include "scriptoptimizer.h"
+#include "scriptslicer.h"
+#include "stringescape.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <iterator>
 
 HistoryModel::HistoryModel(QObject *parent)
     : QAbstractTableModel(parent)
+    , m_displayCache(DisplayCacheSize)
 {
-    LoggerObject::m_model = this;
+    LoggerObject::m_model.store(this, std::memory_order_release);
+
+    m_publishTimer.setSingleShot(true);
+    m_publishTimer.setInterval(m_batchInterval);
+    connect(&m_publishTimer, &QTimer::timeout, this, &HistoryModel::publishRows);
 }
 
 HistoryModel::~HistoryModel()
 {
-    LoggerObject::m_model = nullptr;
+    LoggerObject::m_model.store(nullptr, std::memory_order_release);
 }
 
 int HistoryModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return static_cast<int>(m_data.size());
+    return restoredRows() + m_publishedRows;
 }
 
 int HistoryModel::columnCount(const QModelIndex &parent) const
@@ -26,15 +41,18 @@ int HistoryModel::columnCount(const QModelIndex &parent) const
 
 static QString variantToString(const QVariant &variant)
 {
-    QString text = variant.toString();
     if (static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QString) {
-        text.replace('\\', R"(\\)");
-        text.replace('\n', R"(\n)");
-        text.replace('\t', R"(\t)");
-        text.replace('"', R"(\")");
+        const QString value = variant.toString();
+        QString text;
+        text.reserve(value.size() + value.size() / 16 + 2);
+        text.append('"');
+        appendEscaped(text, value, EscapeMode::Script);
         text.append('"');
-        text.prepend('"');
-    } else if (variant.metaType().flags().testAnyFlag(QMetaType::IsEnumeration)) {
+        return text;
+    }
+
+    QString text = variant.toString();
+    if (variant.metaType().flags().testAnyFlag(QMetaType::IsEnumeration)) {
         QString className = variant.metaType().metaObject()->className();
         className = className.split("::").last();
         text = className + '.' + text;
@@ -42,25 +60,64 @@ static QString variantToString(const QVariant &variant)
     return text;
 }
 
+template <typename Rows>
+static QString paramsToString(const Rows &rows, int row)
+{
+    QStringList paramStrings;
+    for (int i = 0; i < rows.argCount(row); ++i) {
+        QString text = variantToString(rows.argValue(row, i));
+        const QString name = rows.argName(row, i);
+        if (!name.isEmpty())
+            text.prepend(QString("%1: ").arg(name));
+        paramStrings.push_back(text);
+    }
+    const QString returnVariable = rows.returnName(row);
+    return paramStrings.join(", ") + (returnVariable.isEmpty() ? "" : (" => " + returnVariable));
+}
+
+// Records are mostly UTF-16 text
+static qsizetype callSize(const JournalReader &rows, int row)
+{
+    return rows.recordSize(row) / 2;
+}
+
+static qsizetype callSize(const HistoryStore &rows, int row)
+{
+    return ApiRegistry::info(rows.apiId(row)).jsName.size() + rows.textSize(row);
+}
+
+// Accessors for HistoryModel::visitRow
+static const auto recordAt = [](const auto &rows, int row) { return rows.record(row); };
+static const auto apiIdAt = [](const auto &rows, int row) { return rows.apiId(row); };
+static const auto apiNameAt = [](const auto &rows, int row) { return ApiRegistry::info(rows.apiId(row)).name; };
+static const auto paramsAt = [](const auto &rows, int row) { return paramsToString(rows, row); };
+static const auto callSizeAt = [](const auto &rows, int row) { return callSize(rows, row); };
+static const auto textsAt = [](const auto &rows, int row) { return HistoryIndex::texts(rows, row); };
+static const auto argNamesAt = [](const auto &rows, int row) {
+    QStringList names;
+    for (int i = 0; i < rows.argCount(row); ++i)
+        names.push_back(rows.argName(row, i));
+    return names;
+};
+static const auto returnNameAt = [](const auto &rows, int row) { return rows.returnName(row); };
+
 QVariant HistoryModel::data(const QModelIndex &index, int role) const
 {
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole) {
+        const int row = index.row();
         switch (index.column()) {
         case NameCol:
-            return m_data.at(index.row()).name;
+            return visitRow(row, apiNameAt);
         case ParamCol: {
-            const auto &params = m_data.at(index.row()).params;
-            QStringList paramStrings;
-            for (const auto &param : params) {
-                QString text = variantToString(param.value);
-                if (!param.name.isEmpty())
-                    text.prepend(QString("%1: ").arg(param.name));
-                paramStrings.push_back(text);
-            }
-            const QString returnVariable = m_data.at(index.row()).returnArg.name;
-            return paramStrings.join(", ") + (returnVariable.isEmpty() ? "" : (" => " + returnVariable));
+            // Rows are cached by position in the whole history, so they stay valid when the first rows are removed
+            const qint64 key = m_evictedRows + row;
+            if (const QString *cached = m_displayCache.object(key))
+                return *cached;
+            const QString text = visitRow(row, paramsAt);
+            m_displayCache.insert(key, new QString(text), std::max<qsizetype>(text.size(), 1));
+            return text;
         }
         }
     }
@@ -69,7 +126,17 @@ QVariant HistoryModel::data(const QModelIndex &index, int role) const
 
 QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    if (orientation == Qt::Vertical || role != Qt::DisplayRole)
+    if (orientation == Qt::Vertical)
+        return {};
+
+    if (role == Qt::ToolTipRole) {
+        const auto stats = m_store.stats();
+        return tr("%1 rows, %2 bytes per row (%3 bytes per row as individual records)")
+            .arg(stats.rows)
+            .arg(stats.bytesPerRow(), 0, 'f', 1)
+            .arg(stats.recordBytesPerRow(), 0, 'f', 1);
+    }
+    if (role != Qt::DisplayRole)
         return {};
 
     switch (section) {
@@ -83,94 +150,538 @@ QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int
 
 void HistoryModel::clear()
 {
+    m_publishTimer.stop();
+    beginResetModel();
+    m_restored.close();
+    m_restoredHead = 0;
+    m_store.clear();
+    m_publishedRows = 0;
+    m_firstChangedRow = -1;
+    m_evictedRows = 0;
+    m_displayCache.clear();
+    m_index.clear();
+    if (m_journal.isOpen())
+        m_journal.clear();
+    m_archiveReader.close();
+    m_archiveStale = true;
+    if (m_archive.isOpen())
+        m_archive.clear();
+    endResetModel();
+}
+
+bool HistoryModel::openJournal(const QString &fileName)
+{
+    closeJournal();
+    if (!m_journal.open(fileName))
+        return false;
+
     beginResetModel();
-    m_data.clear();
+    m_restored.open(fileName);
+    // Rows evicted before are still in the journal, they were archived already
+    m_restoredHead = static_cast<int>(std::min<qint64>(m_restored.removedRows(), m_restored.size()));
+    if (restoredRows() == 0) {
+        m_restored.close();
+        m_restoredHead = 0;
+    }
+    m_displayCache.clear();
+    // Restored rows are before the store rows, they are indexed when searching
+    m_index.clear();
+    m_index.removeBefore(m_evictedRows);
+    for (int row = 0; row < m_store.size(); ++row)
+        m_journal.appendRow(m_store.record(row));
+    m_journal.flush();
     endResetModel();
+
+    // The restored rows may be over the limits
+    publishRows();
+    return true;
+}
+
+void HistoryModel::closeJournal()
+{
+    m_journal.close();
+}
+
+void HistoryModel::setMaxRows(int maxRows)
+{
+    m_maxRows = std::max(maxRows, 0);
+    evictRows();
+}
+
+void HistoryModel::setMaxBytes(qsizetype maxBytes)
+{
+    m_maxBytes = std::max<qsizetype>(maxBytes, 0);
+    evictRows();
+}
+
+bool HistoryModel::openArchive(const QString &fileName)
+{
+    closeArchive();
+    if (!m_archive.open(fileName))
+        return false;
+    m_archiveFileName = fileName;
+    m_archiveStale = true;
+    return true;
+}
+
+void HistoryModel::closeArchive()
+{
+    m_archive.close();
+    m_archiveReader.close();
+    m_archiveFileName.clear();
+}
+
+int HistoryModel::archivedRows() const
+{
+    refreshArchive();
+    return m_archiveReader.size();
+}
+
+void HistoryModel::refreshArchive() const
+{
+    if (!m_archiveStale || m_archiveFileName.isEmpty())
+        return;
+    m_archiveReader.open(m_archiveFileName);
+    m_archiveStale = false;
+}
+
+void HistoryModel::setBatchInterval(int msec)
+{
+    m_batchInterval = msec;
+    if (msec < 0)
+        publishRows();
+    else
+        m_publishTimer.setInterval(msec);
+}
+
+// Write the arguments of a call, as a property assignment or a function call
+template <typename Output, typename WriteParam>
+static void writeArguments(const ApiRegistry::ApiInfo &api, int argCount, WriteParam writeParam, Output &output)
+{
+    if (api.isProperty) {
+        if (argCount > 0) {
+            output += QStringView(u" = ");
+            writeParam(0);
+        }
+    } else {
+        output += QChar(u'(');
+        for (int i = 0; i < argCount; ++i) {
+            if (i > 0)
+                output += QStringView(u", ");
+            writeParam(i);
+        }
+        output += QChar(u')');
+    }
+}
+
+template <typename Rows, typename Output>
+static void writeCall(const Rows &rows, int row, QHash<QString, QVariant> &returnVariables, Output &output)
+{
+    const auto &api = ApiRegistry::info(rows.apiId(row));
+
+    // Set the return value
+    if (rows.hasReturn(row)) {
+        const QString name = rows.returnName(row);
+        if (!returnVariables.contains(name))
+            output += QStringView(u"let ");
+        output += name;
+        output += QStringView(u" = ");
+        returnVariables[name] = rows.returnValue(row);
+    }
+
+    // Pass the parameters
+    auto writeParam = [&](int i) {
+        const QString name = rows.argName(row, i);
+        const QVariant value = rows.argValue(row, i);
+        if (!name.isEmpty() && returnVariables.value(name) == value)
+            output += name;
+        else
+            output += variantToString(value);
+    };
+
+    output += api.jsName;
+    writeArguments(api, rows.argCount(row), writeParam, output);
+    output += QChar(u'\n');
+}
+
+template <typename Output>
+static void writeLoop(const ScriptCompressor::Loop &loop, Output &output)
+{
+    output += QString("for (let i = 0; i < %1; ++i) {\n").arg(loop.count);
+    for (size_t call = 0; call < loop.body.size(); ++call) {
+        const auto &record = loop.body[call];
+        const auto &api = ApiRegistry::info(record.apiId);
+
+        // Loop calls have no named argument, integer arguments may depend on the iteration
+        auto writeParam = [&](int i) {
+            output += variantToString(record.params[i].value);
+            const int step = loop.steps[call][i];
+            if (step != 0)
+                output += QString(step > 0 ? " + %1 * i" : " - %1 * i").arg(qAbs(static_cast<qint64>(step)));
+        };
+
+        output += QStringView(u"    ");
+        output += api.jsName;
+        writeArguments(api, static_cast<int>(record.params.size()), writeParam, output);
+        output += QChar(u'\n');
+    }
+    output += QStringView(u"}\n");
 }
 
-QString HistoryModel::createScript(int start, int end)
+// Give access to a single record, with the same accessors as the HistoryStore
+struct RecordRows
+{
+    const HistoryStore::Record &record;
+
+    ApiId apiId(int) const { return record.apiId; }
+    int argCount(int) const { return static_cast<int>(record.params.size()); }
+    QString argName(int, int arg) const { return record.params.at(arg).name; }
+    QVariant argValue(int, int arg) const { return record.params.at(arg).value; }
+    bool hasReturn(int) const { return !record.returnArg.isEmpty(); }
+    QString returnName(int) const { return record.returnArg.name; }
+    QVariant returnValue(int) const { return record.returnArg.value; }
+};
+
+template <typename Output>
+void HistoryModel::generateScript(int start, int end, Output &output, ScriptOptions options, ScriptStats *stats) const
 {
     std::tie(start, end) = std::minmax(start, end);
-    Q_ASSERT(start >= 0 && start <= end && end < static_cast<int>(m_data.size()));
+    refreshArchive();
+    Q_ASSERT(start >= -m_archiveReader.size() && start <= end && end < restoredRows() + m_store.size());
 
-    QString scriptText = "// Description of the script\n\n";
+    output += QStringView(u"// Description of the script\n\n");
 
     QHash<QString, QVariant> returnVariables;
+    const int recordedCalls = end - start + 1;
+    const std::vector<bool> sliced = (options & SliceScript) ? sliceRows(start, end) : std::vector<bool>();
+    auto isInSlice = [&](int row) { return sliced.empty() || sliced[row - start]; };
 
-    for (int row = start; row <= end; ++row) {
-        const auto &data = m_data.at(row);
-        QString apiCall = data.name;
-        const bool isProperty = m_properties.contains(apiCall);
-        apiCall.replace("::", ".");
-
-        // Set the return value
-        QString returnValue;
-        if (!data.returnArg.isEmpty()) {
-            const auto &name = data.returnArg.name;
-            returnValue = (returnVariables.contains(name) ? "" : "let ") + name + " = ";
-            returnVariables[name] = data.returnArg.value;
-        }
+    auto writeFooter = [&](const ScriptStats &result) {
+        output += QString("\n// %1 calls eliminated (%2 recorded, %3 generated, %4 loops)\n")
+                      .arg(result.eliminatedCalls())
+                      .arg(result.recordedCalls)
+                      .arg(result.generatedCalls)
+                      .arg(result.loops);
+        if (stats)
+            *stats = result;
+    };
 
-        // Pass the parameters
-        QStringList paramStrings;
-        for (const auto &param : data.params) {
-            if (!param.name.isEmpty() && returnVariables.value(param.name) == param.value) {
-                paramStrings.push_back(param.name);
+    if (!(options & (OptimizeScript | RollLoops))) {
+        auto writeRow = [&](const auto &rows, int row) { writeCall(rows, row, returnVariables, output); };
+        int generatedCalls = 0;
+        for (int row = start; row <= end; ++row) {
+            if (!isInSlice(row))
                 continue;
-            }
-
-            QString text = variantToString(param.value);
-            paramStrings.push_back(text);
+            visitRow(row, writeRow);
+            ++generatedCalls;
         }
+        if (options & SliceScript)
+            writeFooter({recordedCalls, generatedCalls, 0});
+        else if (stats)
+            *stats = {recordedCalls, recordedCalls, 0};
+        return;
+    }
 
-        if (isProperty) {
-            if (paramStrings.isEmpty())
-                scriptText += returnValue + apiCall + '\n';
-            else
-                scriptText += returnValue + QString("%1 = %2\n").arg(apiCall, paramStrings.first());
-        } else {
-            scriptText += returnValue + QString("%1(%2)\n").arg(apiCall, paramStrings.join(", "));
-        }
+    // Calls go through the optimizer, then the loop compressor
+    auto writeRecord = [&](const HistoryStore::Record &record) {
+        writeCall(RecordRows {record}, 0, returnVariables, output);
+    };
+    ScriptCompressor compressor(writeRecord, [&](const ScriptCompressor::Loop &loop) { writeLoop(loop, output); });
+    auto compress = [&](HistoryStore::Record &&record) {
+        if (options & RollLoops)
+            compressor.push(std::move(record));
+        else
+            writeRecord(record);
+    };
+    ScriptOptimizer optimizer(compress);
+
+    for (int row = start; row <= end; ++row) {
+        if (!isInSlice(row))
+            continue;
+        auto record = visitRow(row, recordAt);
+        if (options & OptimizeScript)
+            optimizer.push(std::move(record));
+        else
+            compress(std::move(record));
+    }
+    optimizer.finish();
+    compressor.finish();
+
+    ScriptStats result {recordedCalls, recordedCalls, compressor.loopCount()};
+    if (options & RollLoops)
+        result.generatedCalls = compressor.outputCalls();
+    else
+        result.generatedCalls = optimizer.outputCalls();
+    writeFooter(result);
+}
+
+std::vector<bool> HistoryModel::sliceRows(int start, int end) const
+{
+    // The slice is found backward, from the target row
+    std::vector<bool> sliced(end - start + 1, false);
+    ScriptSlicer slicer;
+    for (int row = end; row >= start; --row) {
+        sliced[row - start] =
+            slicer.addPrevious(visitRow(row, apiIdAt), visitRow(row, argNamesAt), visitRow(row, returnNameAt));
     }
+    return sliced;
+}
 
+QString HistoryModel::createScript(int start, int end, ScriptOptions options, ScriptStats *stats)
+{
+    QString scriptText;
+    scriptText.reserve(estimateScriptSize(start, end));
+    generateScript(start, end, scriptText, options, stats);
     return scriptText;
 }
 
-QString HistoryModel::createScript(const QModelIndex &startIndex, const QModelIndex &endIndex)
+bool HistoryModel::writeScript(int start, int end, QIODevice *device, ScriptOptions options, ScriptStats *stats)
+{
+    ChunkedWriter writer(device);
+    generateScript(start, end, writer, options, stats);
+    return writer.flush();
+}
+
+std::optional<NativeReplay> HistoryModel::createReplay(int start, int end) const
+{
+    std::tie(start, end) = std::minmax(start, end);
+    refreshArchive();
+
+    NativeReplay replay;
+    for (int row = start; row <= end; ++row) {
+        if (!replay.addRecord(visitRow(row, recordAt)))
+            return std::nullopt;
+    }
+    return replay;
+}
+
+qsizetype HistoryModel::estimateScriptSize(int start, int end) const
+{
+    std::tie(start, end) = std::minmax(start, end);
+    refreshArchive();
+
+    // Call overhead: parenthesis, separators, new line, and a bit more for escaping
+    constexpr qsizetype CallOverhead = 8;
+    qsizetype size = 32;
+    for (int row = start; row <= end; ++row)
+        size += visitRow(row, callSizeAt) + CallOverhead;
+    return size;
+}
+
+QString HistoryModel::createScript(const QModelIndex &startIndex, const QModelIndex &endIndex,
+                                   ScriptOptions options, ScriptStats *stats)
 {
     Q_ASSERT(checkIndex(startIndex, CheckIndexOption::IndexIsValid)
              && checkIndex(endIndex, CheckIndexOption::IndexIsValid));
-    return createScript(startIndex.row(), endIndex.row());
+    return createScript(startIndex.row(), endIndex.row(), options, stats);
+}
+
+void HistoryModel::submit(LogData &&data, bool merge)
+{
+    if (QThread::currentThread() == thread()) {
+        // Keep the calls ordered: previous calls from other threads go first
+        drainPending();
+        addData(std::move(data), merge);
+        return;
+    }
+
+    PendingData pending {std::move(data), merge};
+    // The queue is only full if the model thread is blocked, wait for it to catch up
+    while (!m_pending.tryPush(pending))
+        QThread::yieldCurrentThread();
+
+    if (!m_drainScheduled.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, &HistoryModel::drainPending, Qt::QueuedConnection);
+}
+
+void HistoryModel::drainPending()
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+
+    // Reset the flag first, so a call pushed after the last pop schedules a new drain
+    m_drainScheduled.store(false, std::memory_order_release);
+    PendingData pending;
+    while (m_pending.tryPop(pending))
+        addData(std::move(pending.data), pending.merge);
 }
 
 void HistoryModel::addData(LogData &&data, bool merge)
 {
-    if (!merge || m_data.empty() || m_data.back().name != data.name) {
-        beginInsertRows({}, static_cast<int>(m_data.size()), static_cast<int>(m_data.size()));
-        m_data.push_back(std::move(data));
+    if (!merge || !mergeIntoLast(data)) {
+        m_store.append(data);
+        if (m_journal.isOpen())
+            m_journal.appendRow(data);
+        m_lastRowCalls = 1;
+        m_lastRowTimer.start();
+        // The last row can still be merged, it's indexed when the next one is added or when searching
+        if (m_store.size() > 1)
+            indexStoreRow(m_store.size() - 2);
+    }
+
+    if (m_batchInterval < 0)
+        publishRows();
+    else if (!m_publishTimer.isActive())
+        m_publishTimer.start();
+}
+
+bool HistoryModel::mergeIntoLast(const LogData &data)
+{
+    if (m_store.isEmpty() || m_store.apiId(m_store.size() - 1) != data.apiId)
+        return false;
+
+    const auto limits = m_mergePolicies.limits(data.apiId);
+    if (limits.rowBudget > 0 && m_lastRowCalls >= limits.rowBudget)
+        return false;
+    if (limits.timeWindow > 0 && m_lastRowTimer.elapsed() > limits.timeWindow)
+        return false;
+    if (!m_store.mergeIntoLast(data, m_mergePolicies))
+        return false;
+
+    ++m_lastRowCalls;
+    const int lastRow = m_store.size() - 1;
+    m_displayCache.remove(m_evictedRows + restoredRows() + lastRow);
+    // Indexing the whole merged text on each merge is quadratic, it's indexed again once
+    if (m_evictedRows + restoredRows() + lastRow == m_index.nextRow() - 1)
+        m_index.reindexLast();
+    if (m_journal.isOpen())
+        m_journal.replaceLastRow(m_store.record(lastRow));
+    if (lastRow < m_publishedRows && (m_firstChangedRow == -1 || lastRow < m_firstChangedRow))
+        m_firstChangedRow = lastRow;
+    return true;
+}
+
+void HistoryModel::publishRows()
+{
+    const int firstStoreRow = restoredRows();
+
+    // Rows changed before being published don't need a dataChanged
+    if (m_firstChangedRow != -1) {
+        emit dataChanged(index(firstStoreRow + m_firstChangedRow, ParamCol),
+                         index(firstStoreRow + m_publishedRows - 1, ParamCol));
+        m_firstChangedRow = -1;
+    }
+
+    if (m_store.size() > m_publishedRows) {
+        beginInsertRows({}, firstStoreRow + m_publishedRows, firstStoreRow + m_store.size() - 1);
+        m_publishedRows = m_store.size();
         endInsertRows();
+    }
+
+    evictRows();
+
+    // Written once per publication, so a crash loses at most one batch
+    m_journal.flush();
+}
+
+void HistoryModel::evictRows()
+{
+    // Only published rows are removed, and the last row is kept as it can still be merged
+    const int evictableRows = restoredRows() + m_publishedRows - 1;
+    int count = m_maxRows > 0 ? std::min(rowCount() - m_maxRows, evictableRows) : 0;
+    if (m_maxBytes > 0 && m_store.memoryUsage() > m_maxBytes) {
+        int storeRows = std::max(count - restoredRows(), 0);
+        qsizetype bytes = m_store.memoryUsage();
+        for (int row = 0; row < storeRows; ++row)
+            bytes -= m_store.rowBytes(row);
+        while (bytes > m_maxBytes && restoredRows() + storeRows < evictableRows)
+            bytes -= m_store.rowBytes(storeRows++);
+        count = restoredRows() + storeRows;
+    }
+    if (count <= 0)
         return;
+
+    beginRemoveRows({}, 0, count - 1);
+    if (m_archive.isOpen()) {
+        for (int row = 0; row < count; ++row)
+            m_archive.appendRow(visitRow(row, recordAt));
+        m_archive.flush();
+        m_archiveStale = true;
+    }
+    // Written after the archive: a crash may archive rows twice, but never loses them
+    if (m_journal.isOpen()) {
+        m_journal.removeFirstRows(count);
+        m_journal.flush();
     }
 
-    auto &lastData = m_data.back();
-    // Add parameters together
-    for (size_t i = 0; i < data.params.size(); ++i) {
-        const auto &param = data.params[i];
-        auto &lastParam = lastData.params[i];
-        switch (static_cast<QMetaType::Type>(param.value.typeId())) {
-        case QMetaType::Int:
-            lastParam.value = lastParam.value.toInt() + param.value.toInt();
-            break;
-        case QMetaType::QString:
-            lastParam.value = lastParam.value.toString() + param.value.toString();
-            break;
-        case QMetaType::QStringList:
-            lastParam.value = lastParam.value.toStringList() + param.value.toStringList();
-            break;
-        default:
-            Q_UNREACHABLE();
+    const int restoredCount = std::min(count, restoredRows());
+    m_restoredHead += restoredCount;
+    if (restoredRows() == 0) {
+        m_restored.close();
+        m_restoredHead = 0;
+    }
+    const int storeCount = count - restoredCount;
+    m_store.removeFirst(storeCount);
+    m_publishedRows -= storeCount;
+    if (m_firstChangedRow != -1)
+        m_firstChangedRow = std::max(m_firstChangedRow - storeCount, 0);
+    m_evictedRows += count;
+    m_index.removeBefore(m_evictedRows);
+    endRemoveRows();
+}
+
+void HistoryModel::indexStoreRow(int storeRow)
+{
+    // Only keep the index up to date if it already is, otherwise it's updated when searching
+    const qint64 row = m_evictedRows + restoredRows() + storeRow;
+    if (row == m_index.nextRow())
+        m_index.addRow(row, m_store.apiId(storeRow), HistoryIndex::texts(m_store, storeRow));
+}
+
+void HistoryModel::updateIndex() const
+{
+    const int rows = restoredRows() + m_store.size();
+    for (int row = static_cast<int>(m_index.nextRow() - m_evictedRows); row < rows; ++row)
+        m_index.addRow(m_evictedRows + row, visitRow(row, apiIdAt), visitRow(row, textsAt));
+}
+
+static bool apiMatches(ApiId apiId, const QString &apiName)
+{
+    const QString &name = ApiRegistry::info(apiId).name;
+    if (name.compare(apiName, Qt::CaseInsensitive) == 0)
+        return true;
+    return name.endsWith(apiName, Qt::CaseInsensitive) && name.size() > apiName.size() + 1
+        && name.at(name.size() - apiName.size() - 1) == u':';
+}
+
+bool HistoryModel::matches(int row, const Filter &filter) const
+{
+    if (!filter.apiName.isEmpty() && !apiMatches(visitRow(row, apiIdAt), filter.apiName))
+        return false;
+    if (filter.text.isEmpty())
+        return true;
+    const QStringList texts = visitRow(row, textsAt);
+    return std::any_of(texts.cbegin(), texts.cend(),
+                       [&](const QString &text) { return text.contains(filter.text, filter.caseSensitivity); });
+}
+
+std::vector<int> HistoryModel::findRows(const Filter &filter) const
+{
+    updateIndex();
+
+    QList<ApiId> apis;
+    if (!filter.apiName.isEmpty()) {
+        const auto indexedApis = m_index.apis();
+        std::copy_if(indexedApis.cbegin(), indexedApis.cend(), std::back_inserter(apis),
+                     [&](ApiId apiId) { return apiMatches(apiId, filter.apiName); });
+        if (apis.isEmpty())
+            return {};
+    }
+
+    std::vector<int> rows;
+    const int rowCount = this->rowCount();
+    if (const auto candidates = m_index.candidates(apis, filter.text)) {
+        for (const qint64 candidate : *candidates) {
+            const int row = static_cast<int>(candidate - m_evictedRows);
+            if (row >= rowCount)
+                break;
+            if (matches(row, filter))
+                rows.push_back(row);
+        }
+    } else {
+        for (int row = 0; row < rowCount; ++row) {
+            if (matches(row, filter))
+                rows.push_back(row);
         }
     }
-    auto lastIndex = index(static_cast<int>(m_data.size()) - 1, ParamCol);
-    emit dataChanged(lastIndex, lastIndex);
+    return rows;
 }
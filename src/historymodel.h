@@ -1,7 +1,17 @@
 #pragma once
 
+#include "historyindex.h"
+#include "historyjournal.h"
+#include "historystore.h"
+#include "nativereplay.h"
+#include "recordqueue.h"
+
 #include <QAbstractTableModel>
-#include <QSet>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <atomic>
 
 struct LoggerArgBase
 {
@@ -31,6 +41,38 @@ class HistoryModel : public QAbstractTableModel
 public:
     enum Columns { NameCol = 0, ParamCol, ColumnCount };
 
+    enum ScriptOption {
+        NoScriptOption = 0x0,
+        // Remove redundant calls, see ScriptOptimizer
+        OptimizeScript = 0x1,
+        // Replace repeated sequences of calls with loops, see ScriptCompressor
+        RollLoops = 0x2,
+        // Only keep the calls the last row depends on, to reproduce it with a minimal script, see ScriptSlicer
+        SliceScript = 0x4,
+        DefaultScriptOptions = OptimizeScript | RollLoops,
+    };
+    Q_DECLARE_FLAGS(ScriptOptions, ScriptOption)
+
+    struct Filter
+    {
+        // Full API name (TextDocument::insert) or method name (insert), empty for all APIs
+        QString apiName;
+        // Text contained in a parameter, empty for all parameters
+        QString text;
+        Qt::CaseSensitivity caseSensitivity = Qt::CaseInsensitive;
+
+        bool isEmpty() const { return apiName.isEmpty() && text.isEmpty(); }
+    };
+
+    struct ScriptStats
+    {
+        int recordedCalls = 0;
+        // Calls written in the script, the calls of a loop are counted once
+        int generatedCalls = 0;
+        int loops = 0;
+        int eliminatedCalls() const { return recordedCalls - generatedCalls; }
+    };
+
     explicit HistoryModel(QObject *parent = nullptr);
     ~HistoryModel();
 
@@ -41,60 +83,126 @@ public:
 
     void clear();
 
+    /**
+     * @brief Set the interval used to publish new rows to the views
+     * New rows and merged changes are accumulated, and published with one insert range per interval. An interval of 0
+     * publishes them once per event loop iteration, a negative interval publishes each row immediately.
+     */
+    void setBatchInterval(int msec);
+    int batchInterval() const { return m_batchInterval; }
+
+    /**
+     * @brief Policies used to merge calls logged with LOG_AND_MERGE into the last row
+     * The policies are used in the model thread, they should be changed from the model thread only.
+     */
+    MergePolicies &mergePolicies() { return m_mergePolicies; }
+    const MergePolicies &mergePolicies() const { return m_mergePolicies; }
+
+    /**
+     * @brief Record the history in a journal file, so it survives a restart
+     * Rows already in the journal are restored at the beginning of the history, they are read on demand from the
+     * memory-mapped file. New rows, and merges, are then appended to the journal. Evicted rows stay in the journal,
+     * but are not restored.
+     */
+    bool openJournal(const QString &fileName);
+    void closeJournal();
+
+    /**
+     * @brief Limit the size of the history
+     * When the history has more rows than maxRows, or its rows use more than maxBytes of memory, the oldest rows are
+     * removed. A limit of 0 means no limit. Rows restored from the journal are memory-mapped, they only count for the
+     * rows limit.
+     */
+    void setMaxRows(int maxRows);
+    int maxRows() const { return m_maxRows; }
+    void setMaxBytes(qsizetype maxBytes);
+    qsizetype maxBytes() const { return m_maxBytes; }
+    /**
+     * @brief Number of rows removed from the history since it was cleared
+     */
+    qint64 evictedRows() const { return m_evictedRows; }
+
+    /**
+     * @brief Keep the rows removed from the history in an archive journal
+     * Archived rows can still be used to create a script, using negative rows: row -1 is the last archived row.
+     */
+    bool openArchive(const QString &fileName);
+    void closeArchive();
+    int archivedRows() const;
+
+    /**
+     * @brief Find the rows matching a filter
+     * Rows are searched using an index of the APIs and parameters text, built incrementally, so only the rows which may
+     * match are checked.
+     */
+    std::vector<int> findRows(const Filter &filter) const;
+    /**
+     * @brief Returns true if the row matches the filter, without using the index
+     */
+    bool matches(int row, const Filter &filter) const;
+
+    /**
+     * @brief Memory used by the recorded history
+     */
+    HistoryStore::Stats memoryStats() const { return m_store.stats(); }
+
     /**
      * @brief Create a script from 2 points in the history
      * The script is created using 2 rows in the history model. It will create a javascript script.
+     * With SliceScript, the end row is the target call, the script only contains the calls needed to reproduce it.
+     * When optimized, compressed or sliced, the number of calls eliminated is reported at the end of the script, and in
+     * stats if not null. Negative rows are read from the archive, see openArchive.
      */
-    QString createScript(int start, int end);
-    QString createScript(const QModelIndex &startIndex, const QModelIndex &endIndex);
+    QString createScript(int start, int end, ScriptOptions options = DefaultScriptOptions,
+                         ScriptStats *stats = nullptr);
+    QString createScript(const QModelIndex &startIndex, const QModelIndex &endIndex,
+                         ScriptOptions options = DefaultScriptOptions, ScriptStats *stats = nullptr);
 
-    template <typename Object>
-    static void addProperties()
-    {
-        for (int i = 0; i < Object::staticMetaObject.propertyCount(); ++i) {
-            QString className = Object::staticMetaObject.className();
-            m_properties.insert(
-                QString("%1::%2").arg(className.split("::").last()).arg(Object::staticMetaObject.property(i).name()));
-        }
-    }
+    /**
+     * @brief Write a script from 2 points in the history to a device
+     * The script is written incrementally in fixed-size chunks, so a large range can be exported in bounded memory.
+     * Returns false if writing to the device failed.
+     */
+    bool writeScript(int start, int end, QIODevice *device, ScriptOptions options = DefaultScriptOptions,
+                     ScriptStats *stats = nullptr);
+    /**
+     * @brief Create a native replay of 2 points in the history, without going through a script
+     * Returns no value if a call can't be replayed natively.
+     */
+    std::optional<NativeReplay> createReplay(int start, int end) const;
+
+    /**
+     * @brief Estimate the size of the script for 2 points in the history, in characters
+     */
+    qsizetype estimateScriptSize(int start, int end) const;
 
 private:
     friend class LoggerObject;
 
-    struct Arg
-    {
-        QString name;
-        QVariant value;
-        bool isEmpty() const { return name.isEmpty(); }
-    };
-    struct LogData
-    {
-        QString name;
-        std::vector<Arg> params;
-        Arg returnArg;
-    };
+    using Arg = HistoryStore::Arg;
+    using LogData = HistoryStore::Record;
 
-    void logData(const QString &name) { addData(LogData {name, {}}, false); }
+    static LogData createLogData(ApiId apiId) { return LogData {apiId, {}}; }
     template <typename... Ts>
-    void logData(const QString &name, bool merge, Ts... params)
+    static LogData createLogData(ApiId apiId, const Ts &...params)
     {
         LogData data;
-        data.name = name;
+        data.apiId = apiId;
         fillLogData(data, params...);
-        addData(std::move(data), merge);
+        return data;
     }
 
     template <typename T>
-    void setReturnValue(QString &&name, const T &value)
+    static void setReturnValue(LogData &data, QString &&name, const T &value)
     {
-        m_data.back().returnArg.name = std::move(name);
-        m_data.back().returnArg.value = QVariant::fromValue(value);
+        data.returnArg.name = std::move(name);
+        data.returnArg.value = QVariant::fromValue(value);
     }
 
-    void fillLogData(LogData &) {};
+    static void fillLogData(LogData &) {};
 
     template <typename T, typename... Ts>
-    void fillLogData(LogData &data, T param, Ts... params)
+    static void fillLogData(LogData &data, const T &param, const Ts &...params)
     {
         if constexpr (std::derived_from<T, LoggerArgBase>)
             data.params.push_back({param.argName, QVariant::fromValue(param.value)});
@@ -104,8 +212,83 @@ private:
         fillLogData(data, params...);
     }
 
+    /**
+     * @brief Send a recorded call to the model, can be called from any thread
+     * Calls done in the model thread are added directly, other threads go through a lock-free queue, drained by the
+     * model thread in its event loop.
+     */
+    void submit(LogData &&data, bool merge);
+    void drainPending();
+
     void addData(LogData &&data, bool merge);
+    bool mergeIntoLast(const LogData &data);
+    void publishRows();
+    void evictRows();
+    void updateIndex() const;
+    void indexStoreRow(int storeRow);
+    void refreshArchive() const;
+
+    // Rows restored from the journal and still in the history
+    int restoredRows() const { return m_restored.size() - m_restoredHead; }
+    /**
+     * Call function with the rows containing a row of the model, and the position of the row in them: the archive for
+     * negative rows, then the restored rows, then the store.
+     */
+    template <typename Function>
+    decltype(auto) visitRow(int row, Function &&function) const
+    {
+        if (row < 0)
+            return function(m_archiveReader, m_archiveReader.size() + row);
+        if (row < restoredRows())
+            return function(m_restored, m_restoredHead + row);
+        return function(m_store, row - restoredRows());
+    }
+
+    // Rows between start and end kept by the ScriptSlicer, by position from start
+    std::vector<bool> sliceRows(int start, int end) const;
+    template <typename Output>
+    void generateScript(int start, int end, Output &output, ScriptOptions options, ScriptStats *stats) const;
 
-    std::vector<LogData> m_data;
-    inline static QSet<QString> m_properties = {};
+    struct PendingData
+    {
+        LogData data;
+        bool merge = false;
+    };
+    static constexpr size_t PendingCapacity = 4096;
+    RecordQueue<PendingData> m_pending {PendingCapacity};
+    std::atomic_bool m_drainScheduled = false;
+
+    HistoryStore m_store;
+    MergePolicies m_mergePolicies;
+    // Number of calls merged into the last row of the store, and time since the first one
+    int m_lastRowCalls = 0;
+    QElapsedTimer m_lastRowTimer;
+    JournalWriter m_journal;
+    // Rows restored from the journal, before the rows of the store, rows before the head are removed
+    JournalReader m_restored;
+    int m_restoredHead = 0;
+
+    int m_maxRows = 0;
+    qsizetype m_maxBytes = 0;
+    qint64 m_evictedRows = 0;
+    JournalWriter m_archive;
+    QString m_archiveFileName;
+    // Reopened when needed, after rows are archived
+    mutable JournalReader m_archiveReader;
+    mutable bool m_archiveStale = false;
+
+    // Rows visible to the views, the store may contain more rows waiting to be published
+    int m_publishedRows = 0;
+    int m_firstChangedRow = -1;
+    int m_batchInterval = 0;
+    QTimer m_publishTimer;
+
+    // Formatted parameters of the rows displayed, by position in the whole history (evicted rows included), the cost
+    // is the number of characters
+    static constexpr qsizetype DisplayCacheSize = 1024 * 1024;
+    mutable QCache<qint64, QString> m_displayCache;
+    // Index of the rows, by position in the whole history, updated when searching if it's late
+    mutable HistoryIndex m_index;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(HistoryModel::ScriptOptions)
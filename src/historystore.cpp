@@ -0,0 +1,409 @@
+#include "historystore.h"
+
+#include <algorithm>
+#include <cstring>
+
+static qsizetype stringHeapSize(qsizetype length)
+{
+    // Header + UTF-16 data with the null terminator
+    return length == 0 ? 0 : 16 + (length + 1) * static_cast<qsizetype>(sizeof(QChar));
+}
+
+static qsizetype stringHeapSize(const QString &text)
+{
+    return stringHeapSize(text.size());
+}
+
+static qsizetype variantHeapSize(const QVariant &variant)
+{
+    switch (static_cast<QMetaType::Type>(variant.typeId())) {
+    case QMetaType::QString:
+        return stringHeapSize(variant.toString());
+    case QMetaType::QStringList: {
+        const auto list = variant.toStringList();
+        qsizetype size = 16 + list.size() * static_cast<qsizetype>(sizeof(QString));
+        for (const auto &text : list)
+            size += stringHeapSize(text);
+        return size;
+    }
+    default:
+        return variant.metaType().sizeOf() > 16 ? variant.metaType().sizeOf() : 0;
+    }
+}
+
+void HistoryStore::clear()
+{
+    *this = HistoryStore();
+}
+
+HistoryStore::Storage HistoryStore::storageFor(QMetaType metaType)
+{
+    if (metaType.flags().testAnyFlag(QMetaType::IsEnumeration))
+        return Storage::Inline;
+
+    switch (static_cast<QMetaType::Type>(metaType.id())) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+    case QMetaType::QChar:
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return Storage::Inline;
+    case QMetaType::QString:
+        return Storage::String;
+    default:
+        return Storage::Boxed;
+    }
+}
+
+quint32 HistoryStore::intern(const QString &name)
+{
+    if (name.isEmpty())
+        return 0;
+    auto it = m_nameIndex.constFind(name);
+    if (it != m_nameIndex.cend())
+        return it.value();
+
+    const auto id = static_cast<quint32>(m_names.size());
+    m_names.push_back(name);
+    m_nameIndex.insert(name, id);
+    return id;
+}
+
+quint64 HistoryStore::appendString(QStringView text)
+{
+    const auto offset = static_cast<quint64>(m_chars.size());
+    m_chars.append(text);
+    return (offset << 32) | static_cast<quint32>(text.size());
+}
+
+QStringView HistoryStore::stringValue(const Slot &slot) const
+{
+    const auto offset = static_cast<qsizetype>(slot.payload >> 32);
+    const auto length = static_cast<qsizetype>(slot.payload & 0xffffffff);
+    return QStringView(m_chars).mid(offset, length);
+}
+
+HistoryStore::Slot HistoryStore::createSlot(const Arg &arg)
+{
+    Slot slot;
+    slot.nameId = intern(arg.name);
+    slot.typeId = arg.value.typeId();
+
+    switch (storageFor(arg.value.metaType())) {
+    case Storage::Inline:
+        Q_ASSERT(arg.value.metaType().sizeOf() <= static_cast<qsizetype>(sizeof(slot.payload)));
+        std::memcpy(&slot.payload, arg.value.constData(), arg.value.metaType().sizeOf());
+        break;
+    case Storage::String:
+        slot.payload = appendString(arg.value.toString());
+        break;
+    case Storage::Boxed:
+        slot.payload = m_boxed.size();
+        m_boxed.push_back(arg.value);
+        break;
+    }
+    return slot;
+}
+
+QVariant HistoryStore::value(const Slot &slot) const
+{
+    const QMetaType metaType(slot.typeId);
+    switch (storageFor(metaType)) {
+    case Storage::Inline:
+        return QVariant(metaType, &slot.payload);
+    case Storage::String:
+        return stringValue(slot).toString();
+    case Storage::Boxed:
+        return m_boxed[slot.payload];
+    }
+    return {};
+}
+
+// Same as recordBytes(record(row)), without creating the record
+qsizetype HistoryStore::recordBytes(int row) const
+{
+    const quint32 first = m_argOffsets[m_head + row];
+    const quint32 end = m_argOffsets[m_head + row + 1];
+    qsizetype bytes = static_cast<qsizetype>(sizeof(Record) + argCount(row) * sizeof(Arg))
+        + stringHeapSize(ApiRegistry::info(apiId(row)).name);
+    for (quint32 i = first; i < end; ++i) {
+        const auto &slot = m_slots[i];
+        bytes += stringHeapSize(m_names.at(slot.nameId));
+        switch (storageFor(QMetaType(slot.typeId))) {
+        case Storage::Inline:
+            break;
+        case Storage::String:
+            bytes += stringHeapSize(static_cast<qsizetype>(slot.payload & 0xffffffff));
+            break;
+        case Storage::Boxed:
+            bytes += variantHeapSize(m_boxed[slot.payload]);
+            break;
+        }
+    }
+    return bytes;
+}
+
+qsizetype HistoryStore::recordBytes(const Record &record)
+{
+    qsizetype bytes = static_cast<qsizetype>(sizeof(Record) + record.params.size() * sizeof(Arg))
+        + stringHeapSize(ApiRegistry::info(record.apiId).name) + stringHeapSize(record.returnArg.name)
+        + variantHeapSize(record.returnArg.value);
+    for (const auto &param : record.params)
+        bytes += stringHeapSize(param.name) + variantHeapSize(param.value);
+    return bytes;
+}
+
+void HistoryStore::append(const Record &record)
+{
+    m_apiIds.push_back(record.apiId);
+    for (const auto &param : record.params)
+        m_slots.push_back(createSlot(param));
+
+    quint8 flags = NoFlag;
+    if (!record.returnArg.isEmpty()) {
+        m_slots.push_back(createSlot(record.returnArg));
+        flags |= HasReturn;
+    }
+    m_flags.push_back(flags);
+    m_argOffsets.push_back(static_cast<quint32>(m_slots.size()));
+
+    m_recordBytes += recordBytes(record);
+    m_memoryUsage += rowBytes(size() - 1);
+}
+
+void HistoryStore::removeFirst(int count)
+{
+    Q_ASSERT(count >= 0 && count <= size());
+    for (int row = 0; row < count; ++row) {
+        m_recordBytes -= recordBytes(row);
+        m_memoryUsage -= rowBytes(row);
+        for (quint32 i = m_argOffsets[m_head + row]; i < m_argOffsets[m_head + row + 1]; ++i) {
+            if (storageFor(QMetaType(m_slots[i].typeId)) == Storage::String)
+                m_deadChars += static_cast<qsizetype>(m_slots[i].payload & 0xffffffff);
+        }
+    }
+    m_head += count;
+    compactIfNeeded();
+}
+
+// Amortized: each compaction moves at most as much data as was removed since the previous one
+void HistoryStore::compactIfNeeded()
+{
+    if ((m_head >= MinCompactRows && m_head > size())
+        || (m_deadChars >= MinCompactChars && m_deadChars > m_chars.size() / 2))
+        compact();
+}
+
+void HistoryStore::compact()
+{
+    HistoryStore store;
+    store.m_apiIds.reserve(size());
+    store.m_argOffsets.reserve(size() + 1);
+    store.m_flags.reserve(size());
+    store.m_slots.reserve(m_slots.size() - m_argOffsets[m_head]);
+
+    for (int row = m_head; row < static_cast<int>(m_apiIds.size()); ++row) {
+        store.m_apiIds.push_back(m_apiIds[row]);
+        store.m_flags.push_back(m_flags[row]);
+        for (quint32 i = m_argOffsets[row]; i < m_argOffsets[row + 1]; ++i) {
+            Slot slot = m_slots[i];
+            switch (storageFor(QMetaType(slot.typeId))) {
+            case Storage::Inline:
+                break;
+            case Storage::String:
+                slot.payload = store.appendString(stringValue(slot));
+                break;
+            case Storage::Boxed:
+                store.m_boxed.push_back(std::move(m_boxed[slot.payload]));
+                slot.payload = store.m_boxed.size() - 1;
+                break;
+            }
+            store.m_slots.push_back(slot);
+        }
+        store.m_argOffsets.push_back(static_cast<quint32>(store.m_slots.size()));
+    }
+
+    // Name ids are kept
+    store.m_names = std::move(m_names);
+    store.m_nameIndex = std::move(m_nameIndex);
+    store.m_recordBytes = m_recordBytes;
+    store.m_memoryUsage = m_memoryUsage;
+    *this = std::move(store);
+}
+
+bool HistoryStore::mergeIntoLast(const Record &record, const MergePolicies &policies)
+{
+    Q_ASSERT(!isEmpty());
+    const int row = size() - 1;
+    if (static_cast<int>(record.params.size()) != argCount(row))
+        return false;
+    const quint32 firstSlot = m_argOffsets[m_head + row];
+
+    // Merge all arguments first, so the row is unchanged if one of them can't be merged
+    std::vector<QVariant> merged(record.params.size());
+    for (size_t i = 0; i < record.params.size(); ++i) {
+        const auto &param = record.params[i];
+        const auto &slot = m_slots[firstSlot + i];
+        if (slot.typeId != param.value.typeId())
+            return false;
+        if (isInPlaceMerge(policies.policy(record.apiId, param.value.metaType()), slot.typeId))
+            continue;
+        merged[i] = value(slot);
+        if (!policies.merge(record.apiId, merged[i], param.value))
+            return false;
+    }
+
+    m_memoryUsage -= rowBytes(row);
+    for (size_t i = 0; i < record.params.size(); ++i) {
+        const auto &param = record.params[i];
+        auto &slot = m_slots[firstSlot + i];
+        if (merged[i].isValid()) {
+            setValue(slot, merged[i]);
+        } else if (slot.typeId == QMetaType::Int) {
+            int value;
+            std::memcpy(&value, &slot.payload, sizeof(value));
+            value += param.value.toInt();
+            std::memcpy(&slot.payload, &value, sizeof(value));
+        } else {
+            replaceString(slot, stringValue(slot).toString() + param.value.toString());
+        }
+    }
+    m_memoryUsage += rowBytes(row);
+    compactIfNeeded();
+    return true;
+}
+
+// Integers added and strings concatenated are merged directly in the slot
+bool HistoryStore::isInPlaceMerge(MergePolicies::Policy policy, int typeId)
+{
+    return (policy == MergePolicies::Sum && typeId == QMetaType::Int)
+        || (policy == MergePolicies::Concat && typeId == QMetaType::QString);
+}
+
+void HistoryStore::setValue(Slot &slot, const QVariant &value)
+{
+    Q_ASSERT(slot.typeId == value.typeId());
+    switch (storageFor(value.metaType())) {
+    case Storage::Inline:
+        std::memcpy(&slot.payload, value.constData(), value.metaType().sizeOf());
+        break;
+    case Storage::String:
+        replaceString(slot, value.toString());
+        break;
+    case Storage::Boxed:
+        m_boxed[slot.payload] = value;
+        break;
+    }
+}
+
+void HistoryStore::replaceString(Slot &slot, QStringView text)
+{
+    const auto offset = static_cast<qsizetype>(slot.payload >> 32);
+    const auto length = static_cast<qsizetype>(slot.payload & 0xffffffff);
+    if (offset + length == m_chars.size()) {
+        // Last string of the arena, resized in place
+        m_chars.resize(offset);
+        m_chars.append(text);
+    } else if (text.size() <= length) {
+        // Rewritten in place, the end of the old string is unused until the next compaction
+        std::copy(text.begin(), text.end(), m_chars.begin() + offset);
+        m_deadChars += length - text.size();
+    } else {
+        m_deadChars += length;
+        slot.payload = appendString(text);
+        return;
+    }
+    slot.payload = (static_cast<quint64>(offset) << 32) | static_cast<quint32>(text.size());
+}
+
+int HistoryStore::argCount(int row) const
+{
+    const int count = static_cast<int>(m_argOffsets[m_head + row + 1] - m_argOffsets[m_head + row]);
+    return hasReturn(row) ? count - 1 : count;
+}
+
+QString HistoryStore::returnName(int row) const
+{
+    if (!hasReturn(row))
+        return {};
+    return m_names.at(m_slots[m_argOffsets[m_head + row + 1] - 1].nameId);
+}
+
+QVariant HistoryStore::returnValue(int row) const
+{
+    if (!hasReturn(row))
+        return {};
+    return value(m_slots[m_argOffsets[m_head + row + 1] - 1]);
+}
+
+HistoryStore::Record HistoryStore::record(int row) const
+{
+    Record record;
+    record.apiId = apiId(row);
+    const int count = argCount(row);
+    record.params.reserve(count);
+    for (int i = 0; i < count; ++i)
+        record.params.push_back({argName(row, i), argValue(row, i)});
+    if (hasReturn(row))
+        record.returnArg = {returnName(row), returnValue(row)};
+    return record;
+}
+
+qsizetype HistoryStore::textSize(int row) const
+{
+    constexpr qsizetype ValueSize = 8;
+    qsizetype size = 0;
+    for (quint32 i = m_argOffsets[m_head + row]; i < m_argOffsets[m_head + row + 1]; ++i) {
+        const auto &slot = m_slots[i];
+        if (storageFor(QMetaType(slot.typeId)) == Storage::String)
+            size += static_cast<qsizetype>(slot.payload & 0xffffffff) + 2;
+        else
+            size += ValueSize;
+    }
+    return size;
+}
+
+qsizetype HistoryStore::rowBytes(int row) const
+{
+    qsizetype bytes = static_cast<qsizetype>(sizeof(ApiId) + sizeof(quint32) + sizeof(quint8));
+    for (quint32 i = m_argOffsets[m_head + row]; i < m_argOffsets[m_head + row + 1]; ++i) {
+        const auto &slot = m_slots[i];
+        bytes += static_cast<qsizetype>(sizeof(Slot));
+        switch (storageFor(QMetaType(slot.typeId))) {
+        case Storage::Inline:
+            break;
+        case Storage::String:
+            bytes += static_cast<qsizetype>(slot.payload & 0xffffffff) * static_cast<qsizetype>(sizeof(QChar));
+            break;
+        case Storage::Boxed:
+            bytes += static_cast<qsizetype>(sizeof(QVariant)) + variantHeapSize(m_boxed[slot.payload]);
+            break;
+        }
+    }
+    return bytes;
+}
+
+HistoryStore::Stats HistoryStore::stats() const
+{
+    Stats stats;
+    stats.rows = size();
+    stats.bytes = static_cast<qsizetype>(m_apiIds.capacity() * sizeof(ApiId)
+                                         + m_argOffsets.capacity() * sizeof(quint32)
+                                         + m_flags.capacity() * sizeof(quint8) + m_slots.capacity() * sizeof(Slot)
+                                         + m_boxed.capacity() * sizeof(QVariant))
+        + m_chars.capacity() * static_cast<qsizetype>(sizeof(QChar));
+    for (const auto &variant : m_boxed)
+        stats.bytes += variantHeapSize(variant);
+    for (const auto &name : m_names)
+        stats.bytes += static_cast<qsizetype>(sizeof(QString)) + stringHeapSize(name);
+    stats.recordBytes = m_recordBytes;
+    return stats;
+}
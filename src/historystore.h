@@ -0,0 +1,141 @@
+#pragma once
+
+#include "apiregistry.h"
+#include "mergepolicies.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include <vector>
+
+/**
+ * @brief The HistoryStore class is the compact storage used by the HistoryModel
+ *
+ * Recorded calls are stored as a structure of arrays: one column per row property, and all arguments of all rows in a
+ * single arena of fixed-size slots, addressed by offset. APIs are stored by id and argument names are interned. String
+ * values are stored in one character arena, and small values (int, bool, enums, floating point) are encoded inline in
+ * the slot. Anything else is kept in a QVariant on the side.
+ *
+ * The oldest rows can be removed in constant time: they are skipped using a head index, and the storage is compacted
+ * once there are more removed rows than rows left. Strings replaced by a merge are rewritten in place when possible,
+ * otherwise the storage is also compacted once the old strings use more than half of the character arena.
+ */
+class HistoryStore
+{
+public:
+    struct Arg
+    {
+        QString name;
+        QVariant value;
+        bool isEmpty() const { return name.isEmpty(); }
+    };
+    struct Record
+    {
+        ApiId apiId = ApiRegistry::InvalidApi;
+        std::vector<Arg> params;
+        Arg returnArg;
+    };
+
+    struct Stats
+    {
+        qsizetype rows = 0;
+        qsizetype bytes = 0;
+        // Memory used by the same rows stored as individual Record, for comparison
+        qsizetype recordBytes = 0;
+
+        double bytesPerRow() const { return rows ? static_cast<double>(bytes) / rows : 0.; }
+        double recordBytesPerRow() const { return rows ? static_cast<double>(recordBytes) / rows : 0.; }
+    };
+
+    int size() const { return static_cast<int>(m_apiIds.size()) - m_head; }
+    bool isEmpty() const { return size() == 0; }
+    void clear();
+    /**
+     * Remove the count first rows.
+     */
+    void removeFirst(int count);
+
+    void append(const Record &record);
+    /**
+     * Merge the record parameters into the last row, using the merge policies. Returns false, leaving the row
+     * unchanged, if one of the parameters can't be merged.
+     */
+    bool mergeIntoLast(const Record &record, const MergePolicies &policies);
+
+    ApiId apiId(int row) const { return m_apiIds[m_head + row]; }
+    QString apiName(int row) const { return ApiRegistry::info(apiId(row)).name; }
+    int argCount(int row) const;
+    QString argName(int row, int arg) const { return m_names.at(m_slots[m_argOffsets[m_head + row] + arg].nameId); }
+    QVariant argValue(int row, int arg) const { return value(m_slots[m_argOffsets[m_head + row] + arg]); }
+    bool hasReturn(int row) const { return m_flags[m_head + row] & HasReturn; }
+    QString returnName(int row) const;
+    QVariant returnValue(int row) const;
+
+    Record record(int row) const;
+    /**
+     * Approximate size of the arguments of a row once converted to text, in characters
+     */
+    qsizetype textSize(int row) const;
+
+    /**
+     * Approximate memory used by a row, and by all the rows, in bytes
+     */
+    qsizetype rowBytes(int row) const;
+    qsizetype memoryUsage() const { return m_memoryUsage; }
+
+    Stats stats() const;
+
+private:
+    enum Flag : quint8 { NoFlag = 0x0, HasReturn = 0x1 };
+
+    struct Slot
+    {
+        quint32 nameId = 0;
+        int typeId = QMetaType::UnknownType;
+        // Inline value, position in the string arena or index in the boxed values, depending on the type
+        quint64 payload = 0;
+    };
+
+    enum class Storage { Inline, String, Boxed };
+    static Storage storageFor(QMetaType metaType);
+
+    quint32 intern(const QString &name);
+    Slot createSlot(const Arg &arg);
+    QVariant value(const Slot &slot) const;
+    void setValue(Slot &slot, const QVariant &value);
+    void replaceString(Slot &slot, QStringView text);
+    static bool isInPlaceMerge(MergePolicies::Policy policy, int typeId);
+    QStringView stringValue(const Slot &slot) const;
+    quint64 appendString(QStringView text);
+    static qsizetype recordBytes(const Record &record);
+    qsizetype recordBytes(int row) const;
+    void compact();
+    void compactIfNeeded();
+
+    // Removed rows are compacted when there are more than this, and more than rows left
+    static constexpr int MinCompactRows = 1024;
+    // Same for the characters of the strings replaced by a merge
+    static constexpr qsizetype MinCompactChars = 64 * 1024;
+
+    // Row columns, rows before the head are removed
+    int m_head = 0;
+    std::vector<ApiId> m_apiIds;
+    std::vector<quint32> m_argOffsets = {0}; // rows + 1 entries
+    std::vector<quint8> m_flags;
+
+    // Argument arena, the return value is stored as the last slot of a row
+    std::vector<Slot> m_slots;
+    QString m_chars;
+    // Characters of m_chars not used by any row anymore
+    qsizetype m_deadChars = 0;
+    std::vector<QVariant> m_boxed;
+
+    // Interned argument names, 0 is the empty name
+    QStringList m_names = {QString()};
+    QHash<QString, quint32> m_nameIndex;
+
+    qsizetype m_recordBytes = 0;
+    qsizetype m_memoryUsage = 0;
+};
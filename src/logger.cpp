@@ -13,18 +13,15 @@ LoggerDisabler::~LoggerDisabler()
     LoggerObject::m_canLog = m_originalCanLog;
 }
 
-LoggerObject::LoggerObject()
-    : m_firstLogger(m_canLog)
+void LoggerObject::submit()
 {
-}
-
-LoggerObject::~LoggerObject()
-{
-    if (m_firstLogger)
-        m_canLog = true;
+    if (m_record) {
+        if (auto model = m_model.load(std::memory_order_acquire))
+            model->submit(std::move(*m_record), m_merge);
+    }
+    m_canLog = true;
 }
 
 void LoggerObject::log(QString &&string) {
     qDebug() << string;
-    m_canLog = false;
 }
@@ -1,25 +1,36 @@
 #pragma once
 
+#include "apiregistry.h"
 #include "historymodel.h"
 #include "logger_utility.h"
 
 #include <QString>
 
+#include <atomic>
+#include <optional>
+
+#ifdef API_LOGGING_DISABLED
+
+#define LOG(name, ...)                                                                                                 \
+    do {                                                                                                               \
+    } while (false)
+#define LOG_AND_MERGE(name, ...)                                                                                       \
+    do {                                                                                                               \
+    } while (false)
+#define LOG_RETURN(name, value) return value
+
+#else
+
 /**
  * Log a method, with all its parameters.
  */
-#define LOG(name, ...) LoggerObject __loggerObject(name, false, ##__VA_ARGS__)
+#define LOG(name, ...) LOG_IMPL(name, false, ##__VA_ARGS__)
 
 /**
  * Log a method, with all its parameters. If the previous log is also the same method, it will be merged into one
  * operation
  */
-#define LOG_AND_MERGE(name, ...) LoggerObject __loggerObject(name, true, ##__VA_ARGS__)
-
-/**
- * Create a parameter, the name will depend on the type
- */
-#define LOG_ARG(name, value) LoggerArg(name, value)
+#define LOG_AND_MERGE(name, ...) LOG_IMPL(name, true, ##__VA_ARGS__)
 
 /**
  * Save the returned value, the name will depend on the type
@@ -27,14 +38,28 @@
 #define LOG_RETURN(name, value)                                                                                        \
     do {                                                                                                               \
         const auto &__value = value;                                                                                   \
-        __loggerObject.setReturnValue(name, __value);                                                                  \
+        if (__loggerObject.isActive())                                                                                 \
+            __loggerObject.setReturnValue(QStringLiteral(name), __value);                                              \
         return __value;                                                                                                \
     } while (false)
 
+// The parameters are only evaluated if the call is recorded, a disabled or nested call costs a single branch
+#define LOG_IMPL(name, merge, ...)                                                                                     \
+    LoggerObject __loggerObject;                                                                                       \
+    if (__loggerObject.isActive())                                                                                     \
+        __loggerObject.record(LOG_API_ID(name), merge, ##__VA_ARGS__)
+
+#endif
+
+/**
+ * Create a parameter, the name will depend on the type
+ */
+#define LOG_ARG(name, value) LoggerArg(name, value)
+
 /**
  * Register all properties for an object
  */
-#define LOG_REGISTER(Type) HistoryModel::addProperties<Type>()
+#define LOG_REGISTER(Type) ApiRegistry::addProperties<Type>()
 
 /**
  * @brief The LoggerDisabler class is a RAII class to temporary disable logging
@@ -53,54 +78,75 @@ private:
  * @brief The LoggerObject class is a utility class to help logging API calls
  *
  * This class ensure that only the first API call is logged, subsequent calls done by the first one won't.
+ * The guard is per thread, so API calls done in a worker thread are logged independently of the GUI thread. The
+ * recorded call is sent to the HistoryModel when the object is destroyed, once the return value is known.
  * Do not use this class directly, but use the macros LOG and LOG_AND_MERGE
  */
 class LoggerObject
 {
 public:
-    explicit LoggerObject(QString name)
-        : LoggerObject()
+    enum class Level {
+        Off, // Nothing is logged
+        Record, // API calls are recorded in the history
+        Trace, // API calls are recorded in the history and printed in the debug output
+    };
+
+    static void setLevel(Level level) { m_level.store(level, std::memory_order_relaxed); }
+    static Level level() { return m_level.load(std::memory_order_relaxed); }
+
+    // Inline, so a disabled or nested call is a single branch, without any function call
+    LoggerObject()
+        : m_active(m_canLog && level() != Level::Off)
+    {
+    }
+    ~LoggerObject()
     {
-        if (!m_canLog)
-            return;
-        if (m_model)
-            m_model->logData(name);
-        log(std::move(name));
+        if (m_active)
+            submit();
     }
 
+    /**
+     * Returns true if this is the first API call of the current thread, and logging is enabled.
+     */
+    bool isActive() const { return m_active; }
+
     template <typename... Ts>
-    explicit LoggerObject(QString name, bool merge, Ts... params)
-        : LoggerObject()
+    void record(ApiId apiId, bool merge, const Ts &...params)
     {
-        if (!m_canLog)
-            return;
-        if (m_model)
-            m_model->logData(name, merge, params...);
-
-        QStringList paramList;
-        (paramList.push_back(valueToString(params)), ...);
-        QString result = name + " - " + paramList.join(", ");
-        log(std::move(result));
+        Q_ASSERT(m_active);
+        m_canLog = false;
+
+        if (m_model.load(std::memory_order_acquire)) {
+            m_record = HistoryModel::createLogData(apiId, params...);
+            m_merge = merge;
+        }
+
+        if (level() == Level::Trace) {
+            QStringList paramList;
+            (paramList.push_back(valueToString(params)), ...);
+            log(ApiRegistry::info(apiId).name + " - " + paramList.join(", "));
+        }
     }
 
-    ~LoggerObject();
-
     template <typename T>
     void setReturnValue(QString &&name, const T &value)
     {
-        if (m_firstLogger && m_model)
-            m_model->setReturnValue(std::move(name), value);
+        if (m_record)
+            HistoryModel::setReturnValue(*m_record, std::move(name), value);
     }
 
 private:
     friend class HistoryModel;
     friend class LoggerDisabler;
 
-    LoggerObject();
     void log(QString &&string);
+    void submit();
 
-    inline static bool m_canLog = true;
-    bool m_firstLogger = false;
+    inline static thread_local bool m_canLog = true;
+    inline static std::atomic<Level> m_level = Level::Trace;
+    bool m_active = false;
+    bool m_merge = false;
+    std::optional<HistoryModel::LogData> m_record;
 
-    inline static HistoryModel *m_model = nullptr;
+    inline static std::atomic<HistoryModel *> m_model = nullptr;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "stringescape.h"
+
 #include <QMetaEnum>
 #include <QString>
 
@@ -24,12 +26,9 @@ concept HasPointerToString = requires(const T &t)
 template <class T>
 QString valueToString(const T &data)
 {
-    if constexpr (std::is_same_v<std::remove_cvref_t<T>, QString>) {
-        QString text = data;
-        text.replace('\n', "\\n");
-        text.replace('\t', "\\t");
-        return text;
-    } else if constexpr (std::is_same_v<std::remove_cvref_t<T>, bool>)
+    if constexpr (std::is_same_v<std::remove_cvref_t<T>, QString>)
+        return escaped(data, EscapeMode::Display);
+    else if constexpr (std::is_same_v<std::remove_cvref_t<T>, bool>)
         return data ? "true" : "false";
     else if constexpr (std::is_floating_point_v<T> || std::is_integral_v<T>)
         return QString::number(data);
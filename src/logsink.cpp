@@ -0,0 +1,143 @@
+#include "logsink.h"
+
+#include <QStringList>
+
+#include <cstdio>
+
+static const char *messageTypeName(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+    case QtInfoMsg:
+        return "Debug";
+    case QtWarningMsg:
+        return "Warning";
+    case QtCriticalMsg:
+        return "Critical";
+    case QtFatalMsg:
+        return "Fatal";
+    }
+    return "";
+}
+
+LogSink::Message::Message(QtMsgType type, const QMessageLogContext &context, const QString &text)
+    : type(type)
+    , text(text)
+    , file(context.file)
+    , line(context.line)
+    , function(context.function)
+{
+}
+
+QString LogSink::Message::toString() const
+{
+    return QString("%1: %2 (%3:%4, %5)")
+        .arg(messageTypeName(type), text, QString::fromUtf8(file))
+        .arg(line)
+        .arg(QString::fromUtf8(function));
+}
+
+LogSink::LogSink(QObject *parent)
+    : QObject(parent)
+{
+    Q_ASSERT(!s_instance);
+    s_instance = this;
+    m_writer = std::thread(&LogSink::run, this);
+}
+
+LogSink::~LogSink()
+{
+    m_stop = true;
+    m_wakeUp.notify_one();
+    m_writer.join();
+    s_instance = nullptr;
+}
+
+void LogSink::setOutput(Output output)
+{
+    flush();
+    m_output = output;
+}
+
+bool LogSink::setLogFile(const QString &fileName)
+{
+    flush();
+    std::lock_guard lock(m_mutex);
+    m_file.close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return false;
+    m_output = File;
+    return true;
+}
+
+void LogSink::post(QtMsgType type, const QMessageLogContext &context, const QString &text)
+{
+    Message message(type, context, text);
+    if (!m_queue.tryPush(message)) {
+        ++m_dropped;
+        return;
+    }
+    if (m_writerWaiting.load(std::memory_order_acquire))
+        m_wakeUp.notify_one();
+}
+
+void LogSink::flush()
+{
+    std::lock_guard lock(m_mutex);
+    while (!m_queue.isEmpty())
+        writeBatch();
+    if (m_output == Stderr)
+        fflush(stderr);
+    else if (m_output == File)
+        m_file.flush();
+}
+
+void LogSink::run()
+{
+    while (!m_stop) {
+        std::unique_lock lock(m_mutex);
+        if (m_queue.isEmpty()) {
+            // A message posted right before going to sleep is picked up after the flush interval at worst
+            m_writerWaiting = true;
+            m_wakeUp.wait_for(lock, FlushInterval);
+            m_writerWaiting = false;
+        }
+        writeBatch();
+    }
+
+    std::lock_guard lock(m_mutex);
+    while (!m_queue.isEmpty())
+        writeBatch();
+    if (m_output == File)
+        m_file.flush();
+}
+
+void LogSink::writeBatch()
+{
+    // Only the debug view gets the raw text
+    const Output output = m_output.load();
+    QStringList messages;
+    Message message;
+    while (messages.size() < BatchSize && m_queue.tryPop(message))
+        messages.push_back(output == View ? std::move(message.text) : message.toString());
+
+    if (const int dropped = m_dropped.exchange(0))
+        messages.push_back(QString("[%1 messages dropped]").arg(dropped));
+    if (messages.isEmpty())
+        return;
+
+    switch (output) {
+    case Stderr: {
+        const QByteArray data = (messages.join('\n') + '\n').toLocal8Bit();
+        fwrite(data.constData(), 1, data.size(), stderr);
+        break;
+    }
+    case File:
+        m_file.write((messages.join('\n') + '\n').toUtf8());
+        break;
+    case View:
+        emit batchWritten(messages.join('\n'));
+        break;
+    }
+}
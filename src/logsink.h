@@ -0,0 +1,89 @@
+#pragma once
+
+#include "recordqueue.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief The LogSink class writes debug messages from a background thread
+ *
+ * Raw messages are posted from any thread into a bounded lock-free queue, and formatted and written by batch from a
+ * dedicated writer thread to stderr, a file, or the batchWritten signal (used by the debug view). Posting never
+ * blocks: if the queue is full, the message is dropped and the number of dropped messages is reported with the next
+ * batch.
+ */
+class LogSink : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Output { Stderr, File, View };
+
+    /**
+     * @brief A raw message, formatted by the writer thread
+     * The context strings are copied: the context of a message may not outlive the message handler.
+     */
+    struct Message
+    {
+        Message() = default;
+        Message(QtMsgType type, const QMessageLogContext &context, const QString &text);
+        QString toString() const;
+
+        QtMsgType type = QtDebugMsg;
+        QString text;
+        QByteArray file;
+        int line = 0;
+        QByteArray function;
+    };
+
+    explicit LogSink(QObject *parent = nullptr);
+    ~LogSink();
+
+    static LogSink *instance() { return s_instance; }
+
+    Output output() const { return m_output; }
+    void setOutput(Output output);
+    bool setLogFile(const QString &fileName);
+
+    void post(QtMsgType type, const QMessageLogContext &context, const QString &text);
+    /**
+     * Write all pending messages, blocking until done.
+     * Must not be called from the writer thread, which already holds the lock while writing a batch.
+     */
+    void flush();
+    bool isWriterThread() const { return std::this_thread::get_id() == m_writer.get_id(); }
+
+signals:
+    void batchWritten(const QString &batch);
+
+private:
+    void run();
+    void writeBatch();
+
+    static constexpr size_t QueueCapacity = 16384;
+    static constexpr int BatchSize = 1024;
+    static constexpr std::chrono::milliseconds FlushInterval {20};
+
+    RecordQueue<Message> m_queue {QueueCapacity};
+    std::atomic<int> m_dropped = 0;
+    std::atomic<Output> m_output = Stderr;
+    QFile m_file;
+
+    std::mutex m_mutex; // Protects the writer, only used by the writer thread and flush
+    std::condition_variable m_wakeUp;
+    std::atomic_bool m_writerWaiting = false;
+    std::atomic_bool m_stop = false;
+    std::thread m_writer;
+
+    static inline LogSink *s_instance = nullptr;
+};
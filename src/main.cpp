@@ -1,3 +1,4 @@
+#include "logsink.h"
 #include "widget.h"
 
 #include <QApplication>
@@ -5,50 +6,33 @@
 
 void myMessageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    if (Widget::debugView() == 0) {
-        QByteArray localMsg = msg.toLocal8Bit();
-        switch (type) {
-        case QtDebugMsg:
-            fprintf(stderr, "Debug: %s (%s:%u, %s)\n", localMsg.constData(), context.file, context.line,
-                    context.function);
-            break;
-        case QtInfoMsg:
-            fprintf(stderr, "Debug: %s (%s:%u, %s)\n", localMsg.constData(), context.file, context.line,
-                    context.function);
-            break;
-        case QtWarningMsg:
-            fprintf(stderr, "Warning: %s (%s:%u, %s)\n", localMsg.constData(), context.file, context.line,
-                    context.function);
-            break;
-        case QtCriticalMsg:
-            fprintf(stderr, "Critical: %s (%s:%u, %s)\n", localMsg.constData(), context.file, context.line,
-                    context.function);
-            break;
-        case QtFatalMsg:
-            fprintf(stderr, "Fatal: %s (%s:%u, %s)\n", localMsg.constData(), context.file, context.line,
-                    context.function);
+    auto sink = LogSink::instance();
+    if (!sink || type == QtFatalMsg) {
+        // A fatal message from the writer thread is written directly: the writer holds the lock flush() needs
+        if (sink && !sink->isWriterThread())
+            sink->flush();
+        fprintf(stderr, "%s\n", LogSink::Message(type, context, msg).toString().toLocal8Bit().constData());
+        if (type == QtFatalMsg)
             abort();
-        }
-    } else {
-        switch (type) {
-        case QtDebugMsg:
-        case QtInfoMsg:
-        case QtWarningMsg:
-        case QtCriticalMsg:
-            Widget::debugView()->appendPlainText(msg);
-            break;
-        case QtFatalMsg:
-            abort();
-        }
+        return;
     }
+
+    // The raw message is posted, the writer thread formats it for its output
+    sink->post(type, context, msg);
 }
 
 int main(int argc, char *argv[])
 {
+    LogSink logSink;
     qInstallMessageHandler(myMessageOutput);
 
     QApplication a(argc, argv);
     Widget w;
+    QObject::connect(&logSink, &LogSink::batchWritten, Widget::debugView(), &QPlainTextEdit::appendPlainText);
+    logSink.setOutput(LogSink::View);
     w.showMaximized();
-    return a.exec();
+    const int result = a.exec();
+
+    logSink.setOutput(LogSink::Stderr);
+    return result;
 }
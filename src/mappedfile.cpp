@@ -0,0 +1,182 @@
+#include "mappedfile.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include <algorithm>
+
+MappedFile::~MappedFile()
+{
+    m_isStopped = true;
+    if (m_indexer)
+        m_indexer->wait();
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+}
+
+bool MappedFile::open(const QString &fileName)
+{
+    Q_ASSERT(!m_file.isOpen());
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_fileSize = m_file.size();
+    if (m_fileSize == 0) {
+        m_isIndexed = true;
+        return true;
+    }
+    m_data = m_file.map(0, m_fileSize);
+    if (!m_data) {
+        qWarning() << "Can't map" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_blocks.reserve(m_fileSize / BlockBytes + 1);
+    m_indexer.reset(QThread::create(&MappedFile::index, this));
+    m_indexer->start();
+    return true;
+}
+
+void MappedFile::index()
+{
+    qint64 offset = 0;
+    qsizetype position = 0;
+    qsizetype lineBreaks = 0;
+    while (offset < m_fileSize && !m_isStopped) {
+        // Blocks end on a character boundary, so they are decoded separately
+        qint64 end = std::min(offset + BlockBytes, m_fileSize);
+        while (end < m_fileSize && end > offset + 1 && (m_data[end] & 0xC0) == 0x80)
+            --end;
+
+        const QByteArrayView bytes(m_data + offset, end - offset);
+        Block block {m_blocks.size(), offset, end - offset, position, QString::fromUtf8(bytes).size(), lineBreaks,
+                     static_cast<qsizetype>(std::count(bytes.cbegin(), bytes.cend(), '\n'))};
+        offset = end;
+        position += block.length;
+        lineBreaks += block.lineBreaks;
+
+        QMutexLocker locker(&m_mutex);
+        m_blocks.push_back(block);
+        m_blockIndexed.wakeAll();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_isIndexed = true;
+    m_blockIndexed.wakeAll();
+}
+
+bool MappedFile::isIndexed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_isIndexed;
+}
+
+void MappedFile::waitForIndex() const
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_isIndexed)
+        m_blockIndexed.wait(&m_mutex);
+}
+
+qsizetype MappedFile::size() const
+{
+    waitForIndex();
+    return m_blocks.empty() ? 0 : m_blocks.back().position + m_blocks.back().length;
+}
+
+qsizetype MappedFile::lineBreakCount() const
+{
+    waitForIndex();
+    return m_blocks.empty() ? 0 : m_blocks.back().lineBreaksBefore + m_blocks.back().lineBreaks;
+}
+
+std::optional<MappedFile::Block> MappedFile::blockAt(qsizetype position) const
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_blocks.empty() || m_blocks.back().position + m_blocks.back().length <= position) {
+        if (m_isIndexed)
+            return {};
+        m_blockIndexed.wait(&m_mutex);
+    }
+    auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), position,
+                               [](qsizetype position, const Block &block) { return position < block.position; });
+    return *(it - 1);
+}
+
+std::optional<MappedFile::Block> MappedFile::blockOfLineBreak(qsizetype index) const
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_blocks.empty() || m_blocks.back().lineBreaksBefore + m_blocks.back().lineBreaks <= index) {
+        if (m_isIndexed)
+            return {};
+        m_blockIndexed.wait(&m_mutex);
+    }
+    // The first block with the line break, blocks without line breaks have the same count before
+    auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), index, [](qsizetype index, const Block &block) {
+        return index < block.lineBreaksBefore + block.lineBreaks;
+    });
+    return *it;
+}
+
+QString MappedFile::blockText(const Block &block) const
+{
+    if (auto text = m_texts.object(block.index))
+        return *text;
+    auto text = new QString(QString::fromUtf8(QByteArrayView(m_data + block.offset, block.bytes)));
+    Q_ASSERT(text->size() == block.length);
+    m_texts.insert(block.index, text);
+    return *text;
+}
+
+QChar MappedFile::at(qsizetype position) const
+{
+    const auto block = blockAt(position);
+    Q_ASSERT(block);
+    return blockText(*block).at(position - block->position);
+}
+
+QString MappedFile::text(qsizetype from, qsizetype to) const
+{
+    QString result;
+    if (to <= from)
+        return result;
+    forEachBlock(from, [&result, to](qsizetype position, QStringView text) {
+        result.append(text.first(std::min(text.size(), to - position)));
+        return position + text.size() < to;
+    });
+    return result;
+}
+
+qsizetype MappedFile::lineBreaksBefore(qsizetype position) const
+{
+    const auto block = blockAt(position);
+    if (!block)
+        return lineBreakCount();
+    const QString text = blockText(*block);
+    return block->lineBreaksBefore + QStringView(text).first(position - block->position).count(u'\n');
+}
+
+qsizetype MappedFile::lineBreak(qsizetype index) const
+{
+    const auto block = blockOfLineBreak(index);
+    if (!block)
+        return -1;
+    const QString text = blockText(*block);
+    qsizetype found = -1;
+    for (qsizetype i = block->lineBreaksBefore; i <= index; ++i)
+        found = text.indexOf(u'\n', found + 1);
+    Q_ASSERT(found != -1);
+    return block->position + found;
+}
+
+void MappedFile::forEachBlock(qsizetype from, const BlockFunction &function) const
+{
+    from = std::max<qsizetype>(from, 0);
+    for (auto block = blockAt(from); block; block = blockAt(block->position + block->length)) {
+        // The text is kept while used, even if the block is removed from the cache
+        const QString text = blockText(*block);
+        const qsizetype start = std::max<qsizetype>(from - block->position, 0);
+        if (!function(block->position + start, QStringView(text).sliced(start)))
+            return;
+    }
+}
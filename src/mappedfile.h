@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class QThread;
+
+/**
+ * @brief The MappedFile class gives access to the text of a memory-mapped UTF-8 file, without loading it
+ *
+ * The file is cut in blocks of about 1 MiB, indexed by a background thread with their position in characters and
+ * their number of line breaks. Only the blocks used are decoded, and the last ones are kept in a cache. Positions are
+ * in UTF-16 characters, like QString. A call only waits for the indexing of the part of the file it needs.
+ * Not thread-safe, apart from the indexing: a MappedFile is used by one thread.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    /**
+     * Map the file and start indexing it. Returns false if the file can't be opened or mapped.
+     */
+    bool open(const QString &fileName);
+    QString fileName() const { return m_file.fileName(); }
+    bool isIndexed() const;
+
+    // Wait for the whole file to be indexed
+    qsizetype size() const;
+    qsizetype lineBreakCount() const;
+
+    QChar at(qsizetype position) const;
+    QString text(qsizetype from, qsizetype to) const;
+    // Number of line breaks before the position
+    qsizetype lineBreaksBefore(qsizetype position) const;
+    // Position of the line break, or -1 if the file has less line breaks
+    qsizetype lineBreak(qsizetype index) const;
+
+    /**
+     * Call the function with the decoded text from the position, block after block, until it returns false.
+     */
+    using BlockFunction = std::function<bool(qsizetype position, QStringView text)>;
+    void forEachBlock(qsizetype from, const BlockFunction &function) const;
+
+private:
+    static constexpr qint64 BlockBytes = 1024 * 1024;
+    static constexpr int CachedBlocks = 16;
+
+    struct Block
+    {
+        size_t index;
+        qint64 offset;
+        qint64 bytes;
+        qsizetype position;
+        qsizetype length;
+        // Line breaks before the block, and in the block
+        qsizetype lineBreaksBefore;
+        qsizetype lineBreaks;
+    };
+
+    void index();
+    void waitForIndex() const;
+    // The block containing the position, or nothing after the end of the file
+    std::optional<Block> blockAt(qsizetype position) const;
+    std::optional<Block> blockOfLineBreak(qsizetype index) const;
+    QString blockText(const Block &block) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_fileSize = 0;
+
+    mutable QMutex m_mutex;
+    mutable QWaitCondition m_blockIndexed;
+    std::vector<Block> m_blocks;
+    bool m_isIndexed = false;
+    std::atomic_bool m_isStopped = false;
+    std::unique_ptr<QThread> m_indexer;
+
+    mutable QCache<size_t, QString> m_texts {CachedBlocks};
+};
@@ -0,0 +1,149 @@
+#include "mergepolicies.h"
+
+#include <QStringList>
+
+namespace {
+
+template <typename T>
+void add(QVariant &value, const QVariant &next)
+{
+    value = QVariant::fromValue(value.value<T>() + next.value<T>());
+}
+
+bool sum(QVariant &value, const QVariant &next)
+{
+    switch (static_cast<QMetaType::Type>(value.typeId())) {
+    case QMetaType::Int:
+        add<int>(value, next);
+        return true;
+    case QMetaType::UInt:
+        add<uint>(value, next);
+        return true;
+    case QMetaType::LongLong:
+        add<qlonglong>(value, next);
+        return true;
+    case QMetaType::ULongLong:
+        add<qulonglong>(value, next);
+        return true;
+    case QMetaType::Float:
+        add<float>(value, next);
+        return true;
+    case QMetaType::Double:
+        add<double>(value, next);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool concat(QVariant &value, const QVariant &next)
+{
+    switch (static_cast<QMetaType::Type>(value.typeId())) {
+    case QMetaType::QString:
+        add<QString>(value, next);
+        return true;
+    case QMetaType::QStringList:
+        add<QStringList>(value, next);
+        return true;
+    case QMetaType::QByteArray:
+        add<QByteArray>(value, next);
+        return true;
+    case QMetaType::QVariantList:
+        add<QVariantList>(value, next);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool max(QVariant &value, const QVariant &next)
+{
+    const auto order = QVariant::compare(value, next);
+    if (order == QPartialOrdering::Unordered)
+        return false;
+    if (order == QPartialOrdering::Less)
+        value = next;
+    return true;
+}
+
+} // namespace
+
+MergePolicies::MergePolicies()
+{
+    for (auto type : {QMetaType::Int, QMetaType::UInt, QMetaType::LongLong, QMetaType::ULongLong, QMetaType::Float,
+                      QMetaType::Double})
+        setTypePolicy(QMetaType(type), Sum);
+    for (auto type : {QMetaType::QString, QMetaType::QStringList})
+        setTypePolicy(QMetaType(type), Concat);
+}
+
+void MergePolicies::setTypePolicy(QMetaType type, Policy policy)
+{
+    Q_ASSERT(policy != Custom);
+    m_typePolicies.insert(type.id(), {policy, {}});
+}
+
+void MergePolicies::setTypePolicy(QMetaType type, MergeFunction function)
+{
+    m_typePolicies.insert(type.id(), {Custom, std::move(function)});
+}
+
+void MergePolicies::setApiPolicy(ApiId apiId, Policy policy)
+{
+    Q_ASSERT(policy != Custom);
+    m_apiPolicies.insert(apiId, {policy, {}});
+}
+
+void MergePolicies::setApiPolicy(ApiId apiId, MergeFunction function)
+{
+    m_apiPolicies.insert(apiId, {Custom, std::move(function)});
+}
+
+void MergePolicies::resetApiPolicy(ApiId apiId)
+{
+    m_apiPolicies.remove(apiId);
+}
+
+const MergePolicies::Entry *MergePolicies::entry(ApiId apiId, QMetaType type) const
+{
+    auto it = m_apiPolicies.constFind(apiId);
+    if (it != m_apiPolicies.cend())
+        return &it.value();
+    auto typeIt = m_typePolicies.constFind(type.id());
+    if (typeIt != m_typePolicies.cend())
+        return &typeIt.value();
+    return nullptr;
+}
+
+MergePolicies::Policy MergePolicies::policy(ApiId apiId, QMetaType type) const
+{
+    const Entry *policyEntry = entry(apiId, type);
+    return policyEntry ? policyEntry->policy : NoMerge;
+}
+
+bool MergePolicies::merge(ApiId apiId, QVariant &value, const QVariant &next) const
+{
+    if (value.metaType() != next.metaType())
+        return false;
+
+    const Entry *policyEntry = entry(apiId, value.metaType());
+    if (!policyEntry)
+        return false;
+
+    switch (policyEntry->policy) {
+    case NoMerge:
+        return false;
+    case Sum:
+        return sum(value, next);
+    case Concat:
+        return concat(value, next);
+    case LastWins:
+        value = next;
+        return true;
+    case Max:
+        return max(value, next);
+    case Custom:
+        return policyEntry->function(value, next) && value.metaType() == next.metaType();
+    }
+    return false;
+}
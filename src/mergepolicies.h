@@ -0,0 +1,73 @@
+#pragma once
+
+#include "apiregistry.h"
+
+#include <QHash>
+#include <QVariant>
+
+#include <functional>
+
+/**
+ * @brief The MergePolicies class defines how calls logged with LOG_AND_MERGE are merged into the previous row
+ *
+ * A policy can be set per API, for all its arguments, or per argument type. The API policy is used first, then the
+ * type policy. By default, numbers are added, strings and string lists are concatenated, and other types are not
+ * merged: the call is added as a new row.
+ * Merging can also be limited in time, or in number of calls per row, globally or per API.
+ */
+class MergePolicies
+{
+public:
+    enum Policy {
+        NoMerge,
+        Sum,
+        Concat,
+        LastWins,
+        Max,
+        Custom,
+    };
+    /**
+     * Merge next into value, returns false if the values can't be merged.
+     */
+    using MergeFunction = std::function<bool(QVariant &value, const QVariant &next)>;
+
+    struct Limits
+    {
+        // Maximum time between the first and the last call merged into a row, in ms, 0 for no limit
+        int timeWindow = 0;
+        // Maximum number of calls merged into a row, 0 for no limit
+        int rowBudget = 0;
+    };
+
+    MergePolicies();
+
+    void setTypePolicy(QMetaType type, Policy policy);
+    void setTypePolicy(QMetaType type, MergeFunction function);
+    void setApiPolicy(ApiId apiId, Policy policy);
+    void setApiPolicy(ApiId apiId, MergeFunction function);
+    void resetApiPolicy(ApiId apiId);
+
+    void setDefaultLimits(Limits limits) { m_defaultLimits = limits; }
+    void setApiLimits(ApiId apiId, Limits limits) { m_apiLimits.insert(apiId, limits); }
+    Limits limits(ApiId apiId) const { return m_apiLimits.value(apiId, m_defaultLimits); }
+
+    Policy policy(ApiId apiId, QMetaType type) const;
+    /**
+     * Merge next into value, using the policy for the API and the type of value. Returns false if the values can't be
+     * merged, value may be left unchanged or not.
+     */
+    bool merge(ApiId apiId, QVariant &value, const QVariant &next) const;
+
+private:
+    struct Entry
+    {
+        Policy policy = NoMerge;
+        MergeFunction function;
+    };
+    const Entry *entry(ApiId apiId, QMetaType type) const;
+
+    QHash<ApiId, Entry> m_apiPolicies;
+    QHash<int, Entry> m_typePolicies;
+    QHash<ApiId, Limits> m_apiLimits;
+    Limits m_defaultLimits;
+};
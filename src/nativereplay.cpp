@@ -0,0 +1,454 @@
+#include "nativereplay.h"
+#include "textdocument.h"
+
+#include <algorithm>
+
+enum NativeReplay::Opcode : quint8 {
+    GotoStartOfLine,
+    GotoEndOfLine,
+    GotoStartOfWord,
+    GotoEndOfWord,
+    GotoPreviousLine,
+    GotoNextLine,
+    GotoPreviousChar,
+    GotoNextChar,
+    GotoPreviousWord,
+    GotoNextWord,
+    GotoStartOfDocument,
+    GotoEndOfDocument,
+    Unselect,
+    SelectAll,
+    SelectStartOfLine,
+    SelectEndOfLine,
+    SelectStartOfWord,
+    SelectEndOfWord,
+    SelectPreviousLine,
+    SelectNextLine,
+    SelectPreviousChar,
+    SelectNextChar,
+    SelectPreviousWord,
+    SelectNextWord,
+    Remove,
+    Insert,
+    DeleteSelection,
+    DeleteEndOfLine,
+    DeleteStartOfLine,
+    DeleteEndOfWord,
+    DeleteStartOfWord,
+    DeletePreviousCharacter,
+    DeleteNextCharacter,
+    Find,
+    CurrentWord,
+    SelectedText,
+    Foo,
+    Bar,
+    BeginTransaction,
+    CommitTransaction,
+};
+
+namespace {
+
+constexpr int MaxVariables = 0x7fff;
+
+bool isIdentifierChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == u'_' || c == u'$';
+}
+
+QStringView parseIdentifier(QStringView &text)
+{
+    qsizetype size = 0;
+    while (size < text.size() && isIdentifierChar(text[size]))
+        ++size;
+    if (size > 0 && text[0].isDigit())
+        return {};
+    const QStringView identifier = text.first(size);
+    text = text.sliced(size).trimmed();
+    return identifier;
+}
+
+// Parse a string literal as written by variantToString
+std::optional<QString> parseString(QStringView &text)
+{
+    if (!text.startsWith(u'"'))
+        return std::nullopt;
+    QString result;
+    for (qsizetype i = 1; i < text.size(); ++i) {
+        const QChar c = text[i];
+        if (c == u'"') {
+            text = text.sliced(i + 1).trimmed();
+            return result;
+        }
+        if (c != u'\\') {
+            result.append(c);
+            continue;
+        }
+        if (++i == text.size())
+            break;
+        switch (text[i].unicode()) {
+        case u'n':
+            result.append(u'\n');
+            break;
+        case u't':
+            result.append(u'\t');
+            break;
+        case u'\\':
+        case u'"':
+        case u'\'':
+            result.append(text[i]);
+            break;
+        default:
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<int> parseInt(QStringView &text)
+{
+    qsizetype size = text.startsWith(u'-') ? 1 : 0;
+    while (size < text.size() && text[size].isDigit())
+        ++size;
+    bool ok = false;
+    const int value = text.first(size).toInt(&ok);
+    if (!ok)
+        return std::nullopt;
+    text = text.sliced(size).trimmed();
+    return value;
+}
+
+} // namespace
+
+const NativeReplay::OpTable &NativeReplay::opTable()
+{
+    // clang-format off
+    static const OpInfo ops[] = {
+        {"TextDocument::gotoStartOfLine", GotoStartOfLine},
+        {"TextDocument::gotoEndOfLine", GotoEndOfLine},
+        {"TextDocument::gotoStartOfWord", GotoStartOfWord},
+        {"TextDocument::gotoEndOfWord", GotoEndOfWord},
+        {"TextDocument::gotoPreviousLine", GotoPreviousLine, IntArgument},
+        {"TextDocument::gotoNextLine", GotoNextLine, IntArgument},
+        {"TextDocument::gotoPreviousChar", GotoPreviousChar, IntArgument},
+        {"TextDocument::gotoNextChar", GotoNextChar, IntArgument},
+        {"TextDocument::gotoPreviousWord", GotoPreviousWord, IntArgument},
+        {"TextDocument::gotoNextWord", GotoNextWord, IntArgument},
+        {"TextDocument::gotoStartOfDocument", GotoStartOfDocument},
+        {"TextDocument::gotoEndOfDocument", GotoEndOfDocument},
+        {"TextDocument::unselect", Unselect},
+        {"TextDocument::selectAll", SelectAll},
+        {"TextDocument::selectStartOfLine", SelectStartOfLine},
+        {"TextDocument::selectEndOfLine", SelectEndOfLine},
+        {"TextDocument::selectStartOfWord", SelectStartOfWord},
+        {"TextDocument::selectEndOfWord", SelectEndOfWord},
+        {"TextDocument::selectPreviousLine", SelectPreviousLine, IntArgument},
+        {"TextDocument::selectNextLine", SelectNextLine, IntArgument},
+        {"TextDocument::selectPreviousChar", SelectPreviousChar, IntArgument},
+        {"TextDocument::selectNextChar", SelectNextChar, IntArgument},
+        {"TextDocument::selectPreviousWord", SelectPreviousWord, IntArgument},
+        {"TextDocument::selectNextWord", SelectNextWord, IntArgument},
+        {"TextDocument::remove", Remove, IntArgument},
+        {"TextDocument::insert", Insert, StringArgument},
+        {"TextDocument::deleteSelection", DeleteSelection},
+        {"TextDocument::deleteEndOfLine", DeleteEndOfLine},
+        {"TextDocument::deleteStartOfLine", DeleteStartOfLine},
+        {"TextDocument::deleteEndOfWord", DeleteEndOfWord},
+        {"TextDocument::deleteStartOfWord", DeleteStartOfWord},
+        {"TextDocument::deletePreviousCharacter", DeletePreviousCharacter, IntArgument},
+        {"TextDocument::deleteNextCharacter", DeleteNextCharacter, IntArgument},
+        {"TextDocument::find", Find, StringArgument},
+        {"TextDocument::currentWord", CurrentWord, NoArgument, true},
+        {"TextDocument::selectedText", SelectedText, NoArgument, true},
+        {"TextDocument::foo", Foo},
+        {"TextDocument::bar", Bar},
+        {"TextDocument::beginTransaction", BeginTransaction},
+        {"TextDocument::commitTransaction", CommitTransaction},
+    };
+    // clang-format on
+
+    // The APIs are registered here, so the table can be keyed by id even before they are logged
+    static const OpTable table = []() {
+        OpTable result;
+        for (const auto &op : ops) {
+            const ApiId id = ApiRegistry::registerApi(QString::fromLatin1(op.name));
+            result.byId.insert(id, &op);
+            result.byJsName.insert(ApiRegistry::info(id).jsName, &op);
+        }
+        return result;
+    }();
+    return table;
+}
+
+int NativeReplay::variable(const QString &name)
+{
+    const int index = static_cast<int>(m_variables.indexOf(name));
+    if (index != -1)
+        return index;
+    m_variables.push_back(name);
+    m_recordedValues.push_back({});
+    return static_cast<int>(m_variables.size()) - 1;
+}
+
+bool NativeReplay::addRecord(const Record &record)
+{
+    const OpInfo *info = opTable().byId.value(record.apiId, nullptr);
+    if (!info)
+        return false;
+
+    const bool hasResult = !record.returnArg.isEmpty();
+    if (hasResult && (!info->isProperty || m_variables.size() >= MaxVariables))
+        return false;
+    if (record.params.size() != (info->argumentType == NoArgument ? 0 : 1))
+        return false;
+
+    Op op {info->opcode};
+    if (info->argumentType != NoArgument) {
+        const auto &param = record.params.front();
+        const int variableIndex = param.name.isEmpty() ? -1 : static_cast<int>(m_variables.indexOf(param.name));
+        if (info->argumentType == IntArgument) {
+            if (param.value.typeId() != QMetaType::Int)
+                return false;
+            op.argument = param.value.toInt();
+        } else if (param.value.typeId() != QMetaType::QString) {
+            return false;
+        } else if (variableIndex != -1 && m_recordedValues.at(variableIndex) == param.value) {
+            op.isVariable = true;
+            op.argument = variableIndex;
+        } else {
+            op.argument = static_cast<qint32>(m_strings.size());
+            m_strings.push_back(param.value.toString());
+        }
+    }
+    if (hasResult) {
+        op.result = static_cast<qint16>(variable(record.returnArg.name));
+        m_recordedValues[op.result] = record.returnArg.value;
+    }
+    m_ops.push_back(op);
+    return true;
+}
+
+std::optional<NativeReplay> NativeReplay::fromScript(const QString &script)
+{
+    NativeReplay replay;
+    for (const auto line : QStringView(script).tokenize(u'\n')) {
+        if (!replay.parseLine(line))
+            return std::nullopt;
+    }
+    return replay;
+}
+
+// Lines are: a comment, a call, a property read, or a property read assigned to a variable
+bool NativeReplay::parseLine(QStringView line)
+{
+    line = line.trimmed();
+    if (line.isEmpty() || line.startsWith(u"//"))
+        return true;
+    if (line.endsWith(u';'))
+        line.chop(1);
+
+    QStringView identifier = parseIdentifier(line);
+    if (identifier == u"let" || identifier == u"var" || identifier == u"const")
+        identifier = parseIdentifier(line);
+    QString resultName;
+    if (line.startsWith(u'=')) {
+        resultName = identifier.toString();
+        line = line.sliced(1).trimmed();
+        identifier = parseIdentifier(line);
+    }
+
+    // Object.method
+    if (identifier.isEmpty() || !line.startsWith(u'.'))
+        return false;
+    line = line.sliced(1).trimmed();
+    const QStringView method = parseIdentifier(line);
+    const OpInfo *info = opTable().byJsName.value(QString("%1.%2").arg(identifier, method), nullptr);
+    if (!info || (!resultName.isEmpty() && !info->isProperty))
+        return false;
+
+    Op op {info->opcode};
+    if (!info->isProperty) {
+        if (!line.startsWith(u'('))
+            return false;
+        line = line.sliced(1).trimmed();
+        if (info->argumentType == IntArgument) {
+            // The count is optional
+            const auto value = line.startsWith(u')') ? std::optional<int>(1) : parseInt(line);
+            if (!value)
+                return false;
+            op.argument = *value;
+        } else if (info->argumentType == StringArgument) {
+            if (auto text = parseString(line)) {
+                op.argument = static_cast<qint32>(m_strings.size());
+                m_strings.push_back(*text);
+            } else {
+                const auto index = m_variables.indexOf(parseIdentifier(line));
+                if (index == -1)
+                    return false;
+                op.isVariable = true;
+                op.argument = static_cast<qint32>(index);
+            }
+        }
+        if (line != u")")
+            return false;
+    } else if (!line.isEmpty()) {
+        return false;
+    }
+
+    if (!resultName.isEmpty()) {
+        if (m_variables.size() >= MaxVariables)
+            return false;
+        op.result = static_cast<qint16>(variable(resultName));
+    }
+    m_ops.push_back(op);
+    return true;
+}
+
+void NativeReplay::run(TextDocument *document) const
+{
+    State state;
+    run(document, state, size());
+}
+
+bool NativeReplay::run(TextDocument *document, State &state, int count) const
+{
+    Q_ASSERT(document);
+
+    auto &values = state.values;
+    if (values.size() != m_variables.size())
+        values.resize(m_variables.size());
+    const int end = std::min(size(), state.next + count);
+    for (; state.next < end; ++state.next) {
+        const auto &op = m_ops[state.next];
+        auto text = [&]() -> const QString & {
+            return op.isVariable ? values.at(op.argument) : m_strings.at(op.argument);
+        };
+        QString result;
+
+        switch (op.opcode) {
+        case GotoStartOfLine:
+            document->gotoStartOfLine();
+            break;
+        case GotoEndOfLine:
+            document->gotoEndOfLine();
+            break;
+        case GotoStartOfWord:
+            document->gotoStartOfWord();
+            break;
+        case GotoEndOfWord:
+            document->gotoEndOfWord();
+            break;
+        case GotoPreviousLine:
+            document->gotoPreviousLine(op.argument);
+            break;
+        case GotoNextLine:
+            document->gotoNextLine(op.argument);
+            break;
+        case GotoPreviousChar:
+            document->gotoPreviousChar(op.argument);
+            break;
+        case GotoNextChar:
+            document->gotoNextChar(op.argument);
+            break;
+        case GotoPreviousWord:
+            document->gotoPreviousWord(op.argument);
+            break;
+        case GotoNextWord:
+            document->gotoNextWord(op.argument);
+            break;
+        case GotoStartOfDocument:
+            document->gotoStartOfDocument();
+            break;
+        case GotoEndOfDocument:
+            document->gotoEndOfDocument();
+            break;
+        case Unselect:
+            document->unselect();
+            break;
+        case SelectAll:
+            document->selectAll();
+            break;
+        case SelectStartOfLine:
+            document->selectStartOfLine();
+            break;
+        case SelectEndOfLine:
+            document->selectEndOfLine();
+            break;
+        case SelectStartOfWord:
+            document->selectStartOfWord();
+            break;
+        case SelectEndOfWord:
+            document->selectEndOfWord();
+            break;
+        case SelectPreviousLine:
+            document->selectPreviousLine(op.argument);
+            break;
+        case SelectNextLine:
+            document->selectNextLine(op.argument);
+            break;
+        case SelectPreviousChar:
+            document->selectPreviousChar(op.argument);
+            break;
+        case SelectNextChar:
+            document->selectNextChar(op.argument);
+            break;
+        case SelectPreviousWord:
+            document->selectPreviousWord(op.argument);
+            break;
+        case SelectNextWord:
+            document->selectNextWord(op.argument);
+            break;
+        case Remove:
+            document->remove(op.argument);
+            break;
+        case Insert:
+            document->insert(text());
+            break;
+        case DeleteSelection:
+            document->deleteSelection();
+            break;
+        case DeleteEndOfLine:
+            document->deleteEndOfLine();
+            break;
+        case DeleteStartOfLine:
+            document->deleteStartOfLine();
+            break;
+        case DeleteEndOfWord:
+            document->deleteEndOfWord();
+            break;
+        case DeleteStartOfWord:
+            document->deleteStartOfWord();
+            break;
+        case DeletePreviousCharacter:
+            document->deletePreviousCharacter(op.argument);
+            break;
+        case DeleteNextCharacter:
+            document->deleteNextCharacter(op.argument);
+            break;
+        case Find:
+            document->find(text());
+            break;
+        case CurrentWord:
+            result = document->currentWord();
+            break;
+        case SelectedText:
+            result = document->selectedText();
+            break;
+        case Foo:
+            document->foo();
+            break;
+        case Bar:
+            document->bar();
+            break;
+        case BeginTransaction:
+            document->beginTransaction();
+            break;
+        case CommitTransaction:
+            document->commitTransaction();
+            break;
+        }
+
+        if (op.result != -1)
+            values[op.result] = std::move(result);
+    }
+    return state.next == size();
+}
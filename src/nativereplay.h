@@ -0,0 +1,93 @@
+#pragma once
+
+#include "historystore.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <optional>
+#include <vector>
+
+class TextDocument;
+
+/**
+ * @brief The NativeReplay class replays straight-line TextDocument calls without the javascript engine
+ *
+ * Calls are compiled into a compact array of operations, executed with direct calls to the TextDocument methods.
+ * Strings are kept in a pool, and values returned by a call are kept in variables, so they can be passed to later
+ * calls like in a script.
+ * A replay is created from recorded calls, or by parsing a script as created by the HistoryModel. Anything else, like
+ * a loop or a call to another API, can't be replayed natively and needs the javascript engine.
+ */
+class NativeReplay
+{
+public:
+    using Record = HistoryStore::Record;
+
+    /**
+     * Add a recorded call, returns false if it can't be replayed natively. The replay is unchanged in that case.
+     */
+    bool addRecord(const Record &record);
+    /**
+     * Parse a straight-line script, returns no value if the script needs the javascript engine.
+     */
+    static std::optional<NativeReplay> fromScript(const QString &script);
+
+    /**
+     * State of a replay run in several steps
+     */
+    struct State
+    {
+        // Next operation to run
+        int next = 0;
+        QStringList values;
+    };
+
+    void run(TextDocument *document) const;
+    /**
+     * Run at most count operations from the state, returns true once all operations are done.
+     */
+    bool run(TextDocument *document, State &state, int count) const;
+
+    int size() const { return static_cast<int>(m_ops.size()); }
+    bool isEmpty() const { return m_ops.empty(); }
+
+private:
+    enum Opcode : quint8;
+    enum ArgumentType : quint8 { NoArgument, IntArgument, StringArgument };
+
+    struct Op
+    {
+        Opcode opcode;
+        // The argument is the index of a variable, instead of an integer or the index of a string in the pool
+        bool isVariable = false;
+        // Index of the variable set with the returned value, or -1
+        qint16 result = -1;
+        qint32 argument = 0;
+    };
+
+    struct OpInfo
+    {
+        const char *name;
+        Opcode opcode;
+        ArgumentType argumentType = NoArgument;
+        // Properties returning a value, read without parenthesis in a script
+        bool isProperty = false;
+    };
+    struct OpTable
+    {
+        QHash<ApiId, const OpInfo *> byId;
+        QHash<QString, const OpInfo *> byJsName;
+    };
+    static const OpTable &opTable();
+
+    int variable(const QString &name);
+    bool parseLine(QStringView line);
+
+    std::vector<Op> m_ops;
+    QStringList m_strings;
+    QStringList m_variables;
+    // Last value of the variables when recorded, a named argument only uses the variable if the value is the same
+    QVariantList m_recordedValues;
+};
@@ -0,0 +1,291 @@
+#include "piecetable.h"
+
+#include <algorithm>
+
+PieceTable::PieceTable(const QString &text)
+{
+    m_buffers[Original] = text;
+    indexLineBreaks(Original, 0);
+    if (!text.isEmpty()) {
+        m_pieces.push_back({Original, 0, text.size(), static_cast<qsizetype>(m_bufferLineBreaks[Original].size())});
+        m_size = text.size();
+        m_lineBreaks = m_pieces.back().lineBreaks;
+    }
+}
+
+PieceTable::PieceTable(std::shared_ptr<const MappedFile> file)
+    : m_file(std::move(file))
+    , m_isPending(true)
+{
+    Q_ASSERT(m_file);
+}
+
+void PieceTable::complete()
+{
+    if (!m_isPending)
+        return;
+    m_isPending = false;
+    m_size = m_file->size();
+    m_lineBreaks = m_file->lineBreakCount();
+    if (m_size > 0)
+        m_pieces.push_back({Original, 0, m_size, m_lineBreaks});
+    invalidatePositions(0);
+}
+
+void PieceTable::indexLineBreaks(Buffer buffer, qsizetype from)
+{
+    const QString &text = m_buffers[buffer];
+    auto &lineBreaks = m_bufferLineBreaks[buffer];
+    for (qsizetype i = text.indexOf(u'\n', from); i != -1; i = text.indexOf(u'\n', i + 1))
+        lineBreaks.push_back(i);
+}
+
+QStringView PieceTable::pieceText(const Piece &piece) const
+{
+    Q_ASSERT(!isMapped(piece.buffer));
+    return QStringView(m_buffers[piece.buffer]).sliced(piece.start, piece.length);
+}
+
+qsizetype PieceTable::countLineBreaks(Buffer buffer, qsizetype start, qsizetype length) const
+{
+    if (isMapped(buffer))
+        return m_file->lineBreaksBefore(start + length) - m_file->lineBreaksBefore(start);
+    const auto &lineBreaks = m_bufferLineBreaks[buffer];
+    const auto first = std::lower_bound(lineBreaks.cbegin(), lineBreaks.cend(), start);
+    return std::lower_bound(first, lineBreaks.cend(), start + length) - first;
+}
+
+void PieceTable::updatePositions() const
+{
+    // Resized even when valid, a removal leaves the positions of the erased pieces
+    m_piecePositions.resize(m_pieces.size());
+    m_pieceLines.resize(m_pieces.size());
+    if (m_validPositions == m_pieces.size())
+        return;
+
+    qsizetype position = 0;
+    qsizetype lines = 0;
+    if (m_validPositions > 0) {
+        position = m_piecePositions[m_validPositions - 1] + m_pieces[m_validPositions - 1].length;
+        lines = m_pieceLines[m_validPositions - 1] + m_pieces[m_validPositions - 1].lineBreaks;
+    }
+    for (size_t i = m_validPositions; i < m_pieces.size(); ++i) {
+        m_piecePositions[i] = position;
+        m_pieceLines[i] = lines;
+        position += m_pieces[i].length;
+        lines += m_pieces[i].lineBreaks;
+    }
+    m_validPositions = m_pieces.size();
+}
+
+size_t PieceTable::findPiece(qsizetype position) const
+{
+    Q_ASSERT(position >= 0 && position <= m_size);
+    if (position == m_size || m_pieces.empty())
+        return m_pieces.size();
+    updatePositions();
+    const auto it = std::upper_bound(m_piecePositions.cbegin(), m_piecePositions.cend(), position);
+    return static_cast<size_t>(it - m_piecePositions.cbegin()) - 1;
+}
+
+size_t PieceTable::split(qsizetype position)
+{
+    const size_t index = findPiece(position);
+    if (index == m_pieces.size())
+        return index;
+    const qsizetype offset = position - m_piecePositions[index];
+    if (offset == 0)
+        return index;
+
+    Piece &left = m_pieces[index];
+    Piece right {left.buffer, left.start + offset, left.length - offset, 0};
+    right.lineBreaks = countLineBreaks(right.buffer, right.start, right.length);
+    left.length = offset;
+    left.lineBreaks -= right.lineBreaks;
+    m_pieces.insert(m_pieces.begin() + index + 1, right);
+    invalidatePositions(index + 1);
+    return index + 1;
+}
+
+QChar PieceTable::at(qsizetype position) const
+{
+    if (m_isPending)
+        return m_file->at(position);
+    const size_t index = findPiece(position);
+    Q_ASSERT(index < m_pieces.size());
+    const Piece &piece = m_pieces[index];
+    const qsizetype offset = piece.start + position - m_piecePositions[index];
+    return isMapped(piece.buffer) ? m_file->at(offset) : m_buffers[piece.buffer].at(offset);
+}
+
+QString PieceTable::text(qsizetype from, qsizetype to) const
+{
+    // Not clamped to the size, it would wait for the whole mapped file to be indexed
+    from = std::max<qsizetype>(from, 0);
+    QString result;
+    if (to <= from)
+        return result;
+    forEachChunk(from, [&result, to](qsizetype position, QStringView text) {
+        result.append(text.first(std::min(text.size(), to - position)));
+        return position + text.size() < to;
+    });
+    return result;
+}
+
+void PieceTable::forEachChunk(qsizetype from, const ChunkFunction &function) const
+{
+    from = std::max<qsizetype>(from, 0);
+    if (m_isPending) {
+        m_file->forEachBlock(from, function);
+        return;
+    }
+
+    for (size_t i = from < m_size ? findPiece(from) : m_pieces.size(); i < m_pieces.size(); ++i) {
+        const Piece &piece = m_pieces[i];
+        const qsizetype piecePosition = m_piecePositions[i];
+        const qsizetype offset = std::max(from - piecePosition, qsizetype(0));
+        if (!isMapped(piece.buffer)) {
+            if (!function(piecePosition + offset, pieceText(piece).sliced(offset)))
+                return;
+            continue;
+        }
+
+        // Mapped pieces are decoded block by block
+        bool isStopped = false;
+        const qsizetype pieceEnd = piece.start + piece.length;
+        m_file->forEachBlock(piece.start + offset, [&](qsizetype filePosition, QStringView text) {
+            text = text.first(std::min(text.size(), pieceEnd - filePosition));
+            isStopped = !function(piecePosition + filePosition - piece.start, text);
+            return !isStopped && filePosition + text.size() < pieceEnd;
+        });
+        if (isStopped)
+            return;
+    }
+}
+
+void PieceTable::insert(qsizetype position, QStringView text)
+{
+    if (text.isEmpty())
+        return;
+    complete();
+    Q_ASSERT(position >= 0 && position <= m_size);
+
+    // Split while the size is the one of the pieces, an insertion at the end doesn't split the last piece
+    const size_t index = split(position);
+    const qsizetype start = m_buffers[Added].size();
+    m_buffers[Added].append(text);
+    const auto previousLineBreaks = m_bufferLineBreaks[Added].size();
+    indexLineBreaks(Added, start);
+    const auto lineBreaks = static_cast<qsizetype>(m_bufferLineBreaks[Added].size() - previousLineBreaks);
+    m_size += text.size();
+    m_lineBreaks += lineBreaks;
+
+    // Typing extends the piece of the previous insertion
+    if (index > 0) {
+        Piece &previous = m_pieces[index - 1];
+        if (previous.buffer == Added && previous.start + previous.length == start) {
+            previous.length += text.size();
+            previous.lineBreaks += lineBreaks;
+            invalidatePositions(index);
+            return;
+        }
+    }
+    m_pieces.insert(m_pieces.begin() + index, Piece {Added, start, text.size(), lineBreaks});
+    invalidatePositions(index);
+}
+
+void PieceTable::remove(qsizetype position, qsizetype length)
+{
+    if (length == 0)
+        return;
+    complete();
+    Q_ASSERT(position >= 0 && length >= 0 && position + length <= m_size);
+
+    const size_t first = split(position);
+    const size_t last = split(position + length);
+    for (size_t i = first; i < last; ++i)
+        m_lineBreaks -= m_pieces[i].lineBreaks;
+    m_pieces.erase(m_pieces.begin() + first, m_pieces.begin() + last);
+    m_size -= length;
+    invalidatePositions(first);
+}
+
+bool PieceTable::hasLine(qsizetype line) const
+{
+    if (m_isPending)
+        return line == 0 || (line > 0 && m_file->lineBreak(line - 1) != -1);
+    return line >= 0 && line <= m_lineBreaks;
+}
+
+qsizetype PieceTable::lineAt(qsizetype position) const
+{
+    if (m_isPending)
+        return m_file->lineBreaksBefore(position);
+    const size_t index = findPiece(position);
+    if (index == m_pieces.size())
+        return m_lineBreaks;
+    const Piece &piece = m_pieces[index];
+    return m_pieceLines[index] + countLineBreaks(piece.buffer, piece.start, position - m_piecePositions[index]);
+}
+
+qsizetype PieceTable::lineStart(qsizetype line) const
+{
+    if (line == 0)
+        return 0;
+    if (m_isPending)
+        return m_file->lineBreak(line - 1) + 1;
+    Q_ASSERT(line > 0 && line <= m_lineBreaks);
+
+    // The piece containing the line break before the line
+    updatePositions();
+    const auto it = std::upper_bound(m_pieceLines.cbegin(), m_pieceLines.cend(), line - 1);
+    const size_t index = static_cast<size_t>(it - m_pieceLines.cbegin()) - 1;
+    const Piece &piece = m_pieces[index];
+    return m_piecePositions[index] + lineBreakPosition(piece, line - 1 - m_pieceLines[index]) - piece.start + 1;
+}
+
+// Position in the buffer of the line break of the piece
+qsizetype PieceTable::lineBreakPosition(const Piece &piece, qsizetype index) const
+{
+    if (isMapped(piece.buffer))
+        return m_file->lineBreak(m_file->lineBreaksBefore(piece.start) + index);
+    const auto &lineBreaks = m_bufferLineBreaks[piece.buffer];
+    const auto first = std::lower_bound(lineBreaks.cbegin(), lineBreaks.cend(), piece.start);
+    return *(first + index);
+}
+
+qsizetype PieceTable::lineEnd(qsizetype line) const
+{
+    if (m_isPending) {
+        const qsizetype lineBreak = m_file->lineBreak(line);
+        return lineBreak == -1 ? m_file->size() : lineBreak;
+    }
+    return line < m_lineBreaks ? lineStart(line + 1) - 1 : m_size;
+}
+
+qsizetype PieceTable::indexOf(QStringView text, qsizetype from, Qt::CaseSensitivity cs) const
+{
+    from = std::max<qsizetype>(from, 0);
+    if (text.isEmpty())
+        return from <= size() ? from : -1;
+
+    qsizetype result = -1;
+    forEachChunk(from, [&](qsizetype position, QStringView chunk) {
+        // Occurrences across the previous chunks and this one
+        if (position > from) {
+            const qsizetype windowStart = std::max(from, position - text.size() + 1);
+            const QString window = this->text(windowStart, position + text.size() - 1);
+            const qsizetype found = window.indexOf(text, 0, cs);
+            if (found != -1 && windowStart + found < position) {
+                result = windowStart + found;
+                return false;
+            }
+        }
+
+        const qsizetype found = chunk.indexOf(text, 0, cs);
+        if (found != -1)
+            result = position + found;
+        return found == -1;
+    });
+    return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The PieceTable class stores a text as a sequence of pieces of 2 buffers: the original text and the added text
+ *
+ * Edits never move the existing text: an insertion appends to the added buffer, and splits a piece. Consecutive
+ * insertions at the same place extend the same piece. The line breaks of each buffer are indexed once, so the lines of
+ * the text are found by binary search on the pieces, and then on the line breaks of a buffer.
+ * The position of the pieces is computed lazily, from the first piece changed by an edit.
+ *
+ * The original text can be a MappedFile, only decoded where it is used. Until the first edit, calls are forwarded to
+ * the file, so they don't wait for the whole file to be indexed.
+ */
+class PieceTable
+{
+public:
+    PieceTable() = default;
+    explicit PieceTable(const QString &text);
+    explicit PieceTable(std::shared_ptr<const MappedFile> file);
+
+    qsizetype size() const { return m_isPending ? m_file->size() : m_size; }
+    bool isEmpty() const { return size() == 0; }
+    QChar at(qsizetype position) const;
+    QString text(qsizetype from, qsizetype to) const;
+    QString text() const { return text(0, size()); }
+
+    void insert(qsizetype position, QStringView text);
+    void remove(qsizetype position, qsizetype length);
+
+    qsizetype lineCount() const { return (m_isPending ? m_file->lineBreakCount() : m_lineBreaks) + 1; }
+    bool hasLine(qsizetype line) const;
+    // Line of a position, the line break is the last position of a line
+    qsizetype lineAt(qsizetype position) const;
+    qsizetype lineStart(qsizetype line) const;
+    // Position of the line break ending the line, or the size for the last line
+    qsizetype lineEnd(qsizetype line) const;
+
+    /**
+     * Returns the position of the first occurrence of text at or after from, or -1.
+     */
+    qsizetype indexOf(QStringView text, qsizetype from, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+
+    /**
+     * Call the function with the contiguous parts of the text from the position, until it returns false.
+     */
+    using ChunkFunction = std::function<bool(qsizetype position, QStringView text)>;
+    void forEachChunk(qsizetype from, const ChunkFunction &function) const;
+
+private:
+    enum Buffer : quint8 { Original, Added };
+    struct Piece
+    {
+        Buffer buffer;
+        qsizetype start;
+        qsizetype length;
+        qsizetype lineBreaks;
+    };
+
+    bool isMapped(Buffer buffer) const { return buffer == Original && m_file; }
+    // Create the piece of the mapped file before the first edit
+    void complete();
+    QStringView pieceText(const Piece &piece) const;
+    qsizetype countLineBreaks(Buffer buffer, qsizetype start, qsizetype length) const;
+    qsizetype lineBreakPosition(const Piece &piece, qsizetype index) const;
+    void indexLineBreaks(Buffer buffer, qsizetype from);
+    // Index of the piece containing the position, or the number of pieces at the end
+    size_t findPiece(qsizetype position) const;
+    // Split the pieces at the position, returns the index of the piece starting there
+    size_t split(qsizetype position);
+    void updatePositions() const;
+    void invalidatePositions(size_t index) { m_validPositions = std::min(m_validPositions, index); }
+
+    QString m_buffers[2];
+    std::vector<qsizetype> m_bufferLineBreaks[2];
+    std::shared_ptr<const MappedFile> m_file;
+    bool m_isPending = false;
+    std::vector<Piece> m_pieces;
+    qsizetype m_size = 0;
+    qsizetype m_lineBreaks = 0;
+
+    // Position and line breaks before each piece, valid for the first m_validPositions pieces
+    mutable std::vector<qsizetype> m_piecePositions;
+    mutable std::vector<qsizetype> m_pieceLines;
+    mutable size_t m_validPositions = 0;
+};
@@ -0,0 +1,288 @@
+#include "piecetablebackend.h"
+
+#include <QIODevice>
+#include <QTextBoundaryFinder>
+
+#include <algorithm>
+
+void PieceTableBackend::setText(const QString &text)
+{
+    m_table = PieceTable(text);
+    setCursor(0, 0);
+}
+
+bool PieceTableBackend::open(const QString &fileName)
+{
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(fileName))
+        return false;
+    m_table = PieceTable(std::move(file));
+    m_column = -1;
+    setCursor(0, 0);
+    return true;
+}
+
+bool PieceTableBackend::save(QIODevice *device) const
+{
+    bool isWritten = true;
+    m_table.forEachChunk(0, [device, &isWritten](qsizetype, QStringView text) {
+        isWritten = device->write(text.toUtf8()) >= 0;
+        return isWritten;
+    });
+    return isWritten;
+}
+
+void PieceTableBackend::setCursor(qsizetype position, qsizetype anchor)
+{
+    const bool isMoved = position != m_position;
+    const bool isSelectionChanged = isMoved || anchor != m_anchor;
+    m_position = position;
+    m_anchor = anchor;
+    // Notifications are sent once, on commit
+    if (m_isInTransaction)
+        return;
+
+    // Same notifications as QPlainTextEdit
+    if (isMoved && positionChanged)
+        positionChanged();
+    if (isSelectionChanged && selectionChanged)
+        selectionChanged();
+}
+
+QString PieceTableBackend::selectedText() const
+{
+    return m_table.text(std::min(m_position, m_anchor), std::max(m_position, m_anchor));
+}
+
+QString PieceTableBackend::currentWord() const
+{
+    const qsizetype start = startOfWord(m_position);
+    return m_table.text(start, endOfWord(start));
+}
+
+qsizetype PieceTableBackend::nextCharacter(qsizetype position) const
+{
+    if (position >= m_table.size())
+        return m_table.size();
+    const QString window = m_table.text(position, position + MaxClusterLength);
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Grapheme, window);
+    const qsizetype next = finder.toNextBoundary();
+    return position + (next == -1 ? window.size() : next);
+}
+
+qsizetype PieceTableBackend::previousCharacter(qsizetype position) const
+{
+    if (position <= 0)
+        return 0;
+    const qsizetype start = std::max<qsizetype>(position - MaxClusterLength, 0);
+    const QString window = m_table.text(start, position);
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Grapheme, window);
+    finder.toEnd();
+    return start + std::max<qsizetype>(finder.toPreviousBoundary(), 0);
+}
+
+PieceTableBackend::CharClass PieceTableBackend::charClass(qsizetype position) const
+{
+    const QChar c = m_table.at(position);
+    if (c.isSpace())
+        return Space;
+    if (c.isLetterOrNumber() || c == u'_')
+        return Word;
+    return Other;
+}
+
+qsizetype PieceTableBackend::startOfWord(qsizetype position) const
+{
+    while (position > 0 && charClass(position - 1) == Word)
+        --position;
+    return position;
+}
+
+qsizetype PieceTableBackend::endOfWord(qsizetype position) const
+{
+    while (position < m_table.size() && charClass(position) == Word)
+        ++position;
+    return position;
+}
+
+qsizetype PieceTableBackend::nextWord(qsizetype position) const
+{
+    // Stops at the end of a line, then goes to the start of the next one
+    if (position == m_table.size())
+        return position;
+    if (m_table.at(position) == u'\n')
+        return position + 1;
+
+    const CharClass current = charClass(position);
+    if (current != Space) {
+        while (position < m_table.size() && charClass(position) == current)
+            ++position;
+    }
+    while (position < m_table.size() && m_table.at(position) != u'\n' && charClass(position) == Space)
+        ++position;
+    return position;
+}
+
+qsizetype PieceTableBackend::previousWord(qsizetype position) const
+{
+    // Stops at the start of a line, then goes to the end of the previous one
+    if (position == 0)
+        return position;
+    if (m_table.at(position - 1) == u'\n')
+        return position - 1;
+
+    while (position > 0 && m_table.at(position - 1) != u'\n' && charClass(position - 1) == Space)
+        --position;
+    if (position == 0 || m_table.at(position - 1) == u'\n')
+        return position;
+    const CharClass current = charClass(position - 1);
+    while (position > 0 && charClass(position - 1) == current)
+        --position;
+    return position;
+}
+
+qsizetype PieceTableBackend::moveLines(qsizetype position, qsizetype count)
+{
+    const qsizetype line = m_table.lineAt(position);
+    if (m_column < 0)
+        m_column = position - m_table.lineStart(line);
+    // Only waits for the indexing of a mapped file when moving past its last line
+    qsizetype target = std::max<qsizetype>(line + count, 0);
+    if (!m_table.hasLine(target))
+        target = m_table.lineCount() - 1;
+    return std::min(m_table.lineStart(target) + m_column, m_table.lineEnd(target));
+}
+
+void PieceTableBackend::movePosition(MoveOperation operation, MoveMode mode, int count)
+{
+    qsizetype position = m_position;
+    // Consecutive vertical moves keep the column of the first one
+    if (operation == QTextCursor::Up || operation == QTextCursor::Down) {
+        position = moveLines(position, operation == QTextCursor::Up ? -count : count);
+        setCursor(position, mode == QTextCursor::KeepAnchor ? m_anchor : position);
+        return;
+    }
+
+    m_column = -1;
+    // Like QTextCursor, a character move without the anchor first collapses the selection to one of its ends
+    bool hasSelection = mode == QTextCursor::MoveAnchor && m_position != m_anchor;
+    for (int i = 0; i < count; ++i, hasSelection = false) {
+        switch (operation) {
+        case QTextCursor::NoMove:
+            break;
+        case QTextCursor::Start:
+            position = 0;
+            break;
+        case QTextCursor::End:
+            position = m_table.size();
+            break;
+        case QTextCursor::StartOfLine:
+        case QTextCursor::StartOfBlock:
+            position = m_table.lineStart(m_table.lineAt(position));
+            break;
+        case QTextCursor::EndOfLine:
+        case QTextCursor::EndOfBlock:
+            position = m_table.lineEnd(m_table.lineAt(position));
+            break;
+        case QTextCursor::PreviousBlock:
+            position = m_table.lineStart(std::max<qsizetype>(m_table.lineAt(position) - 1, 0));
+            break;
+        case QTextCursor::NextBlock:
+            position = m_table.lineStart(std::min(m_table.lineAt(position) + 1, m_table.lineCount() - 1));
+            break;
+        case QTextCursor::StartOfWord:
+            position = startOfWord(position);
+            break;
+        case QTextCursor::EndOfWord:
+            position = endOfWord(position);
+            break;
+        case QTextCursor::PreviousCharacter:
+        case QTextCursor::Left:
+            position = hasSelection ? std::min(m_position, m_anchor) : previousCharacter(position);
+            break;
+        case QTextCursor::NextCharacter:
+        case QTextCursor::Right:
+            position = hasSelection ? std::max(m_position, m_anchor) : nextCharacter(position);
+            break;
+        case QTextCursor::PreviousWord:
+        case QTextCursor::WordLeft:
+            position = previousWord(position);
+            break;
+        case QTextCursor::NextWord:
+        case QTextCursor::WordRight:
+            position = nextWord(position);
+            break;
+        default:
+            break;
+        }
+    }
+    setCursor(position, mode == QTextCursor::KeepAnchor ? m_anchor : position);
+}
+
+void PieceTableBackend::setPosition(qsizetype position, MoveMode mode)
+{
+    m_column = -1;
+    const qsizetype clamped = std::clamp<qsizetype>(position, 0, m_table.size());
+    setCursor(clamped, mode == QTextCursor::KeepAnchor ? m_anchor : clamped);
+}
+
+void PieceTableBackend::selectAll()
+{
+    m_column = -1;
+    setCursor(m_table.size(), 0);
+}
+
+void PieceTableBackend::clearSelection()
+{
+    setCursor(m_position, m_position);
+}
+
+void PieceTableBackend::insertText(const QString &text)
+{
+    m_column = -1;
+    const qsizetype start = std::min(m_position, m_anchor);
+    m_table.remove(start, std::max(m_position, m_anchor) - start);
+    m_table.insert(start, text);
+    const qsizetype position = start + text.size();
+    // The text changed even if the cursor didn't move
+    if (position == m_position && !m_isInTransaction && positionChanged)
+        positionChanged();
+    setCursor(position, position);
+}
+
+void PieceTableBackend::removeSelectedText()
+{
+    m_column = -1;
+    const qsizetype start = std::min(m_position, m_anchor);
+    m_table.remove(start, std::max(m_position, m_anchor) - start);
+    setCursor(start, start);
+}
+
+bool PieceTableBackend::find(const QString &text)
+{
+    m_column = -1;
+    const qsizetype found = m_table.indexOf(text, std::max(m_position, m_anchor), Qt::CaseInsensitive);
+    if (found == -1 || text.isEmpty())
+        return false;
+    setCursor(found + text.size(), found);
+    return true;
+}
+
+void PieceTableBackend::beginTransaction()
+{
+    Q_ASSERT(!m_isInTransaction);
+    m_isInTransaction = true;
+    m_transactionPosition = m_position;
+    m_transactionAnchor = m_anchor;
+}
+
+void PieceTableBackend::commitTransaction()
+{
+    Q_ASSERT(m_isInTransaction);
+    m_isInTransaction = false;
+    const bool isMoved = m_position != m_transactionPosition;
+    if (isMoved && positionChanged)
+        positionChanged();
+    if ((isMoved || m_anchor != m_transactionAnchor) && selectionChanged)
+        selectionChanged();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "documentbackend.h"
+#include "piecetable.h"
+
+/**
+ * @brief The PieceTableBackend class is a headless DocumentBackend, storing the text in a PieceTable
+ *
+ * There is no layout: lines are the paragraphs of the text, and Up and Down keep the column of the cursor instead of
+ * its horizontal position. Words are runs of letters, digits and underscores, other characters but spaces are words of
+ * their own, like QTextCursor does with a default layout. Character moves go by grapheme cluster, so surrogate pairs
+ * and combining marks are never split. It can be used in any thread.
+ */
+class PieceTableBackend : public DocumentBackend
+{
+public:
+    PieceTableBackend() = default;
+
+    QString text() const override { return m_table.text(); }
+    QString text(qsizetype from, qsizetype to) const override { return m_table.text(from, to); }
+    void forEachChunk(qsizetype from, const ChunkFunction &function) const override
+    {
+        m_table.forEachChunk(from, function);
+    }
+    void setText(const QString &text) override;
+    /**
+     * The file is memory-mapped and indexed in the background, only the parts used are decoded.
+     */
+    bool open(const QString &fileName) override;
+    bool save(QIODevice *device) const override;
+
+    qsizetype position() const override { return m_position; }
+    qsizetype anchor() const override { return m_anchor; }
+    QString selectedText() const override;
+    QString currentWord() const override;
+
+    void movePosition(MoveOperation operation, MoveMode mode, int count) override;
+    void setPosition(qsizetype position, MoveMode mode) override;
+    void selectAll() override;
+    void clearSelection() override;
+
+    void insertText(const QString &text) override;
+    void removeSelectedText() override;
+    bool find(const QString &text) override;
+
+    void beginTransaction() override;
+    void commitTransaction() override;
+
+private:
+    // Longest grapheme cluster handled by the character moves, longer ones are split
+    static constexpr qsizetype MaxClusterLength = 16;
+    qsizetype nextCharacter(qsizetype position) const;
+    qsizetype previousCharacter(qsizetype position) const;
+
+    enum CharClass { Space, Word, Other };
+    CharClass charClass(qsizetype position) const;
+    qsizetype startOfWord(qsizetype position) const;
+    qsizetype endOfWord(qsizetype position) const;
+    qsizetype nextWord(qsizetype position) const;
+    qsizetype previousWord(qsizetype position) const;
+    qsizetype moveLines(qsizetype position, qsizetype count);
+
+    void setCursor(qsizetype position, qsizetype anchor);
+
+    PieceTable m_table;
+    qsizetype m_position = 0;
+    qsizetype m_anchor = 0;
+    // Column kept by consecutive Up and Down moves, -1 otherwise
+    qsizetype m_column = -1;
+
+    bool m_isInTransaction = false;
+    qsizetype m_transactionPosition = 0;
+    qsizetype m_transactionAnchor = 0;
+};
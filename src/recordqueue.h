@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/**
+ * @brief The RecordQueue class is a bounded, lock-free, multi-producer queue
+ *
+ * It is used to hand over recorded API calls from any thread to the thread owning the HistoryModel, without taking a
+ * mutex. Each cell carries a sequence number telling whether it is ready to be written or read (Vyukov's bounded
+ * queue), so producers only contend on a single atomic increment.
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class RecordQueue
+{
+public:
+    explicit RecordQueue(size_t capacity)
+        : m_capacity(roundUpToPowerOfTwo(capacity))
+        , m_mask(m_capacity - 1)
+        , m_cells(new Cell[m_capacity])
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    RecordQueue(const RecordQueue &) = delete;
+    RecordQueue &operator=(const RecordQueue &) = delete;
+
+    /**
+     * Push a value in the queue, returns false if the queue is full.
+     * The value is only moved from if the push succeeds.
+     */
+    bool tryPush(T &value)
+    {
+        Cell *cell = nullptr;
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[position & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pop a value from the queue, returns false if the queue is empty.
+     */
+    bool tryPop(T &value)
+    {
+        Cell *cell = nullptr;
+        size_t position = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[position & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(position + m_capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        const size_t position = m_head.load(std::memory_order_relaxed);
+        const size_t sequence = m_cells[position & m_mask].sequence.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1) < 0;
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Keep producers and consumers on different cache lines
+    static constexpr size_t CacheLineSize = 64;
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(CacheLineSize) std::atomic<size_t> m_tail = 0;
+    alignas(CacheLineSize) std::atomic<size_t> m_head = 0;
+};
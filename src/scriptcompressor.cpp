@@ -0,0 +1,140 @@
+#include "scriptcompressor.h"
+#include "scriptoptimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// A for loop takes 2 more lines than its body
+constexpr int LoopOverhead = 2;
+
+bool isInt(const QVariant &value)
+{
+    return value.typeId() == QMetaType::Int;
+}
+
+} // namespace
+
+ScriptCompressor::ScriptCompressor(CallFunction emitCall, LoopFunction emitLoop, size_t windowSize)
+    : m_emitCall(std::move(emitCall))
+    , m_emitLoop(std::move(emitLoop))
+    , m_windowSize(std::max<size_t>(windowSize, 2 * MaxPeriod))
+{
+}
+
+void ScriptCompressor::push(Record &&record)
+{
+    m_pending.push_back(std::move(record));
+    if (m_pending.size() > m_windowSize)
+        emitFront();
+}
+
+void ScriptCompressor::finish()
+{
+    while (!m_pending.empty())
+        emitFront();
+}
+
+void ScriptCompressor::emitFront()
+{
+    // Find the block saving the most lines
+    int bestPeriod = 0;
+    int bestCount = 0;
+    int bestSaving = 0;
+    std::vector<std::vector<int>> bestSteps;
+    std::vector<std::vector<int>> steps;
+    const int maxPeriod = std::min<int>(MaxPeriod, static_cast<int>(m_pending.size() / 2));
+    for (int period = 1; period <= maxPeriod; ++period) {
+        const int count = repetitions(period, steps);
+        const int saving = (count - 1) * period - LoopOverhead;
+        if (saving > bestSaving) {
+            bestPeriod = period;
+            bestCount = count;
+            bestSaving = saving;
+            bestSteps = std::move(steps);
+        }
+    }
+
+    if (bestPeriod == 0) {
+        ++m_outputCalls;
+        m_emitCall(m_pending.front());
+        m_pending.pop_front();
+        return;
+    }
+
+    Loop loop;
+    loop.count = bestCount;
+    loop.body.reserve(bestPeriod);
+    for (int i = 0; i < bestPeriod; ++i)
+        loop.body.push_back(std::move(m_pending[i]));
+    loop.steps = std::move(bestSteps);
+    m_pending.erase(m_pending.begin(), m_pending.begin() + bestCount * bestPeriod);
+
+    ++m_loopCount;
+    m_outputCalls += bestPeriod;
+    m_emitLoop(loop);
+}
+
+// Returns the number of consecutive repetitions of the first period calls, and the step of their integer arguments
+int ScriptCompressor::repetitions(int period, std::vector<std::vector<int>> &steps) const
+{
+    if (2 * period > static_cast<int>(m_pending.size()))
+        return 1;
+
+    // The steps are given by the 2 first blocks
+    steps.assign(period, {});
+    bool hasStep = false;
+    for (int i = 0; i < period; ++i) {
+        const Record &first = m_pending[i];
+        const Record &second = m_pending[period + i];
+        if (!ScriptOptimizer::isPlain(first) || first.apiId != second.apiId
+            || first.params.size() != second.params.size())
+            return 1;
+        steps[i].assign(first.params.size(), 0);
+        for (size_t arg = 0; arg < first.params.size(); ++arg) {
+            const QVariant &value = first.params[arg].value;
+            const QVariant &nextValue = second.params[arg].value;
+            if (isInt(value) && isInt(nextValue)) {
+                const qint64 step = static_cast<qint64>(nextValue.toInt()) - value.toInt();
+                if (step < std::numeric_limits<int>::min() || step > std::numeric_limits<int>::max())
+                    return 1;
+                steps[i][arg] = static_cast<int>(step);
+                hasStep = hasStep || step != 0;
+            }
+        }
+    }
+    if (!matches(1, period, steps))
+        return 1;
+
+    int count = 2;
+    while ((count + 1) * period <= static_cast<int>(m_pending.size()) && matches(count, period, steps))
+        ++count;
+
+    // 2 values always have a step, it needs a third one to be a sequence
+    return hasStep && count < 3 ? 1 : count;
+}
+
+bool ScriptCompressor::matches(int block, int period, const std::vector<std::vector<int>> &steps) const
+{
+    for (int i = 0; i < period; ++i) {
+        const Record &first = m_pending[i];
+        const Record &record = m_pending[block * period + i];
+        if (first.apiId != record.apiId || first.params.size() != record.params.size()
+            || !ScriptOptimizer::isPlain(record))
+            return false;
+        for (size_t arg = 0; arg < first.params.size(); ++arg) {
+            const QVariant &value = first.params[arg].value;
+            const QVariant &blockValue = record.params[arg].value;
+            if (value.metaType() != blockValue.metaType())
+                return false;
+            if (isInt(value)) {
+                if (blockValue.toInt() != value.toInt() + static_cast<qint64>(block) * steps[i][arg])
+                    return false;
+            } else if (value != blockValue) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
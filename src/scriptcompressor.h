@@ -0,0 +1,62 @@
+#pragma once
+
+#include "historystore.h"
+
+#include <deque>
+#include <functional>
+
+/**
+ * @brief The ScriptCompressor class rolls repeated sequences of calls into loops
+ *
+ * Calls are pushed one by one, and kept in a bounded window. When the window is full (or on finish), the compressor
+ * looks for a block of calls repeated right after itself, starting with the oldest pending call. Repetitions match if
+ * they call the same APIs with the same arguments, except integer arguments which can vary by a constant step at each
+ * repetition (for example gotoNextLine(1), gotoNextLine(2), gotoNextLine(3)...).
+ * Only calls without named argument or return value are part of a loop.
+ */
+class ScriptCompressor
+{
+public:
+    using Record = HistoryStore::Record;
+
+    struct Loop
+    {
+        int count = 0;
+        // Calls of the first iteration
+        std::vector<Record> body;
+        // Step of each argument of each call, added at each iteration, 0 if the argument is constant
+        std::vector<std::vector<int>> steps;
+    };
+
+    using CallFunction = std::function<void(const Record &)>;
+    using LoopFunction = std::function<void(const Loop &)>;
+
+    ScriptCompressor(CallFunction emitCall, LoopFunction emitLoop, size_t windowSize = DefaultWindowSize);
+
+    void push(Record &&record);
+    /**
+     * Emit all the pending calls.
+     */
+    void finish();
+
+    int loopCount() const { return m_loopCount; }
+    /**
+     * Number of calls emitted, the calls of a loop body are counted once.
+     */
+    int outputCalls() const { return m_outputCalls; }
+
+    static constexpr size_t DefaultWindowSize = 4096;
+    static constexpr int MaxPeriod = 32;
+
+private:
+    void emitFront();
+    int repetitions(int period, std::vector<std::vector<int>> &steps) const;
+    bool matches(int block, int period, const std::vector<std::vector<int>> &steps) const;
+
+    CallFunction m_emitCall;
+    LoopFunction m_emitLoop;
+    const size_t m_windowSize;
+    std::deque<Record> m_pending;
+    int m_loopCount = 0;
+    int m_outputCalls = 0;
+};
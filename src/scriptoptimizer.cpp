@@ -0,0 +1,142 @@
+#include "scriptoptimizer.h"
+#include "apisemantics.h"
+
+#include <algorithm>
+
+namespace {
+
+using Record = ScriptOptimizer::Record;
+
+bool hasSingleValue(const Record &record, QMetaType::Type type)
+{
+    return record.params.size() == 1 && record.params.front().value.typeId() == type;
+}
+
+int count(const Record &record)
+{
+    return record.params.front().value.toInt();
+}
+
+bool hasPositiveCount(const Record &record)
+{
+    return hasSingleValue(record, QMetaType::Int) && count(record) > 0;
+}
+
+Record createRecord(ApiId apiId, QVariant value = {})
+{
+    Record record;
+    record.apiId = apiId;
+    if (value.isValid())
+        record.params.push_back({QString(), std::move(value)});
+    return record;
+}
+
+// QTextCursor moves by grapheme clusters, only remove text made of characters that are always one cluster
+bool canRemoveCharacters(const QString &text, qsizetype length)
+{
+    const qsizetype cut = text.size() - length;
+    for (qsizetype i = cut; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c == u'\r' || (c.unicode() >= 0x0300 && c != QChar::LineSeparator && c != QChar::ParagraphSeparator))
+            return false;
+    }
+    return cut == 0 || text.at(cut - 1) != u'\r';
+}
+
+} // namespace
+
+bool ScriptOptimizer::isPlain(const Record &record)
+{
+    if (!record.returnArg.isEmpty())
+        return false;
+    return std::all_of(record.params.cbegin(), record.params.cend(), [](const auto &arg) { return arg.isEmpty(); });
+}
+
+ScriptOptimizer::ScriptOptimizer(EmitFunction emit, size_t windowSize)
+    : m_emit(std::move(emit))
+    , m_windowSize(std::max<size_t>(windowSize, 1))
+{
+}
+
+void ScriptOptimizer::push(Record &&record)
+{
+    ++m_inputCalls;
+    add(std::move(record));
+}
+
+void ScriptOptimizer::finish()
+{
+    while (!m_pending.empty())
+        emitFront();
+}
+
+void ScriptOptimizer::add(Record &&record)
+{
+    // Combine the call with the last pending one, as long as something changes
+    while (!m_pending.empty() && isPlain(record) && isPlain(m_pending.back())) {
+        Record &previous = m_pending.back();
+        const auto &info = ApiSemantics::info(record.apiId);
+        const auto previousKind = ApiSemantics::info(previous.apiId).kind;
+
+        // Same call: add the counts, or concatenate the text
+        if (info.mergeable && previous.apiId == record.apiId) {
+            if (hasPositiveCount(previous) && hasPositiveCount(record)) {
+                record.params.front().value = count(previous) + count(record);
+                m_pending.pop_back();
+                continue;
+            }
+            if (hasSingleValue(previous, QMetaType::QString) && hasSingleValue(record, QMetaType::QString)) {
+                record.params.front().value =
+                    previous.params.front().value.toString() + record.params.front().value.toString();
+                m_pending.pop_back();
+                continue;
+            }
+        }
+
+        // Absolute position and selection: previous cursor changes are useless
+        if ((info.kind == ApiSemantics::AbsoluteMove || info.kind == ApiSemantics::SelectAll)
+            && ApiSemantics::isCursorOnly(previousKind)) {
+            m_pending.pop_back();
+            continue;
+        }
+
+        // Nothing to unselect or delete
+        if ((info.kind == ApiSemantics::Unselect || info.kind == ApiSemantics::DeleteSelection)
+            && ApiSemantics::clearsSelection(previousKind)) {
+            return;
+        }
+
+        // Text inserted, then deleted: only insert what's left. Inserting also deletes the selection.
+        if (record.apiId == ApiSemantics::deletePreviousCharacterApi() && previous.apiId == ApiSemantics::insertApi()
+            && hasPositiveCount(record) && hasSingleValue(previous, QMetaType::QString)) {
+            const QString text = previous.params.front().value.toString();
+            const int length = count(record);
+            if (!canRemoveCharacters(text, std::min<qsizetype>(length, text.size())))
+                break;
+            if (length < text.size()) {
+                previous.params.front().value = text.left(text.size() - length);
+                return;
+            }
+            m_pending.pop_back();
+            add(createRecord(ApiSemantics::deleteSelectionApi()));
+            if (length == text.size())
+                return;
+            record.params.front().value = static_cast<int>(length - text.size());
+            continue;
+        }
+
+        break;
+    }
+
+    m_pending.push_back(std::move(record));
+    if (m_pending.size() > m_windowSize)
+        emitFront();
+}
+
+void ScriptOptimizer::emitFront()
+{
+    ++m_outputCalls;
+    Record record = std::move(m_pending.front());
+    m_pending.pop_front();
+    m_emit(std::move(record));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "historystore.h"
+
+#include <deque>
+#include <functional>
+
+/**
+ * @brief The ScriptOptimizer class removes redundant calls from a recorded history
+ *
+ * It's a peephole optimizer using the semantics of the TextDocument APIs: calls are pushed one by one, and combined
+ * with the previous pending calls when the result is equivalent. For example, consecutive moves are added, moves
+ * before an absolute move are dropped, and text inserted then deleted is never inserted.
+ * The position isn't known, so opposite moves are kept: a move stops at the document boundaries, and the move back
+ * doesn't always return to the start position. An unselect before a relative move is kept too: like QTextCursor, a
+ * character move collapses the selection to its start or end instead of moving from the position.
+ * Calls with a named argument or a return value are never changed, and nothing is combined across them.
+ *
+ * Pending calls are kept in a bounded window, calls leaving the window (or all of them on finish) are passed to the
+ * emit function, so the optimizer can be used while streaming a script.
+ */
+class ScriptOptimizer
+{
+public:
+    using Record = HistoryStore::Record;
+    using EmitFunction = std::function<void(Record &&)>;
+
+    explicit ScriptOptimizer(EmitFunction emit, size_t windowSize = DefaultWindowSize);
+
+    void push(Record &&record);
+    /**
+     * Emit all the pending calls.
+     */
+    void finish();
+
+    int inputCalls() const { return m_inputCalls; }
+    int outputCalls() const { return m_outputCalls; }
+    int eliminatedCalls() const { return m_inputCalls - m_outputCalls; }
+
+    /**
+     * Returns true if the call has no named argument and no return value, so it can be changed or moved.
+     */
+    static bool isPlain(const Record &record);
+
+    static constexpr size_t DefaultWindowSize = 1024;
+
+private:
+    void add(Record &&record);
+    void emitFront();
+
+    EmitFunction m_emit;
+    const size_t m_windowSize;
+    std::deque<Record> m_pending;
+    int m_inputCalls = 0;
+    int m_outputCalls = 0;
+};
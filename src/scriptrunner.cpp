@@ -1,40 +1,490 @@
 #include "scriptrunner.h"
 #include "textdocument.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QFile>
 #include <QQmlComponent>
-#include <QtQml/private/qqmlengine_p.h>
+#include <QSaveFile>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <optional>
+
+namespace {
+
+// Name of the run() argument with the literals of a script template
+const QString LiteralsName = QStringLiteral("__literals");
+
+bool isIdentifierCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == u'_' || c == u'$';
+}
+
+/**
+ * A script with its string and number literals replaced by the elements of an array argument, so the scripts only
+ * differing by their literals, as the ones created from the history, share one compiled component.
+ */
+struct ScriptTemplate
+{
+    QString text;
+    QVariantList literals;
+};
+
+// Returns no value for what isn't parsed: template strings, regular expressions and comments, rare escapes, and
+// literals before a colon (object keys, labels and cases)
+std::optional<ScriptTemplate> scriptTemplate(const QString &script)
+{
+    ScriptTemplate result;
+    result.text.reserve(script.size());
+    auto addLiteral = [&result](QVariant value) {
+        result.text += LiteralsName + u'[' + QString::number(result.literals.size()) + u']';
+        result.literals.push_back(std::move(value));
+    };
+    auto isBeforeColon = [&script](qsizetype i) {
+        while (i < script.size() && script.at(i).isSpace())
+            ++i;
+        return i < script.size() && script.at(i) == u':';
+    };
+
+    for (qsizetype i = 0; i < script.size();) {
+        const QChar c = script.at(i);
+        if (c == u'`' || c == u'/')
+            return std::nullopt;
+
+        if (c == u'"' || c == u'\'') {
+            QString value;
+            qsizetype end = i + 1;
+            for (; end < script.size() && script.at(end) != c; ++end) {
+                QChar character = script.at(end);
+                if (character == u'\n')
+                    return std::nullopt;
+                if (character == u'\\') {
+                    if (++end == script.size())
+                        return std::nullopt;
+                    switch (script.at(end).unicode()) {
+                    case u'n':
+                        character = u'\n';
+                        break;
+                    case u't':
+                        character = u'\t';
+                        break;
+                    case u'r':
+                        character = u'\r';
+                        break;
+                    case u'\\':
+                    case u'"':
+                    case u'\'':
+                        character = script.at(end);
+                        break;
+                    case u'u': {
+                        const QStringView hex = QStringView(script).mid(end + 1, 4);
+                        bool ok = false;
+                        character = QChar(hex.toUShort(&ok, 16));
+                        if (!ok || hex.size() != 4)
+                            return std::nullopt;
+                        end += 4;
+                        break;
+                    }
+                    default:
+                        return std::nullopt;
+                    }
+                }
+                value.append(character);
+            }
+            if (end == script.size() || isBeforeColon(end + 1))
+                return std::nullopt;
+            addLiteral(value);
+            i = end + 1;
+        } else if (c.isDigit() && (i == 0 || !isIdentifierCharacter(script.at(i - 1)))) {
+            qsizetype end = i;
+            while (end < script.size() && (script.at(end).isDigit() || script.at(end) == u'.'))
+                ++end;
+            // Hexadecimal numbers, exponents and big integers
+            if (end < script.size() && isIdentifierCharacter(script.at(end)))
+                return std::nullopt;
+            bool ok = false;
+            const double value = QStringView(script).sliced(i, end - i).toDouble(&ok);
+            if (!ok || isBeforeColon(end))
+                return std::nullopt;
+            addLiteral(value);
+            i = end;
+        } else {
+            result.text.append(c);
+            ++i;
+        }
+    }
+    return result;
+}
+
+} // namespace
 
 ScriptRunner::ScriptRunner(TextDocument *document, QObject *parent)
     : QObject(parent)
+    , m_document(document)
 {
     m_engine = new QQmlEngine(this);
 }
 
-ScriptRunner::~ScriptRunner() { }
+ScriptRunner::~ScriptRunner()
+{
+    // The watchdog keeps cancelling the worker until its run is done
+    cancel();
+    stopWorker();
+    stopWatchdog();
+    // Components use the engine, delete them first
+    m_components.clear();
+}
+
+void ScriptRunner::setCacheDirectory(const QString &path)
+{
+    if (path == m_cacheDirectory)
+        return;
+    if (!path.isEmpty() && !QDir().mkpath(path)) {
+        qWarning() << "Can't create the script cache directory" << path;
+        return;
+    }
+    m_cacheDirectory = path;
+    clearCache();
+    pruneCacheDirectory();
+}
+
+void ScriptRunner::pruneCacheDirectory()
+{
+    if (m_cacheDirectory.isEmpty())
+        return;
+    QFileInfoList files = QDir(m_cacheDirectory).entryInfoList({"*.qml"}, QDir::Files);
+    if (files.size() <= MaxCacheFiles)
+        return;
+    std::sort(files.begin(), files.end(),
+              [](const QFileInfo &a, const QFileInfo &b) { return a.lastRead() > b.lastRead(); });
+    for (qsizetype i = MaxCacheFiles; i < files.size(); ++i)
+        QFile::remove(files.at(i).filePath());
+}
+
+void ScriptRunner::clearCache()
+{
+    m_components.clear();
+    if (m_workerContext) {
+        QMetaObject::invokeMethod(m_workerContext, [this]() {
+            if (m_workerRunner)
+                m_workerRunner->clearCache();
+        });
+    }
+}
 
 void ScriptRunner::runScript(const QString &script)
 {
-    qDebug() << "==> Start script";
+    begin();
+    if (m_document)
+        m_document->beginTransaction();
+    m_replay = m_document ? NativeReplay::fromScript(script) : std::nullopt;
+    if (m_replay) {
+        bool isDone = false;
+        while (!isDone && !isInterrupted())
+            isDone = m_replay->run(m_document, m_replayState, SliceCalls);
+    } else {
+        runJavascript(script);
+    }
+    end();
+}
+
+void ScriptRunner::start(const QString &script)
+{
+    if (m_isRunning) {
+        qWarning() << "A script is already running";
+        return;
+    }
+
+    begin();
+    m_replay = m_document ? NativeReplay::fromScript(script) : std::nullopt;
+    if (m_replay) {
+        m_document->beginTransaction();
+        QTimer::singleShot(0, this, &ScriptRunner::runNextSlice);
+        return;
+    }
+
+    if (m_document) {
+        startWorker(script);
+        return;
+    }
+
+    // Without a document, there is nothing to copy in the worker
+    QTimer::singleShot(0, this, [this, script]() {
+        if (!isInterrupted())
+            runJavascript(script);
+        end();
+    });
+}
+
+void ScriptRunner::cancel()
+{
+    m_isCancelled = true;
+    QMutexLocker locker(&m_watchdogMutex);
+    interruptJavascript();
+}
+
+void ScriptRunner::interruptJavascript()
+{
+    m_engine->setInterrupted(true);
+    if (m_workerRunner)
+        m_workerRunner->cancel();
+}
 
+void ScriptRunner::begin()
+{
+    qDebug() << "==> Start script";
+    m_isRunning = true;
     m_hasError = false;
-    runJavascript(script);
+    m_errors.clear();
+    m_isCancelled = false;
+    m_isOverBudget = false;
+    m_engine->setInterrupted(false);
+    m_replayState = {};
+    m_runTimer.start();
+    m_sliceTimer.start();
+    emit started();
+}
+
+void ScriptRunner::end()
+{
+    stopWatchdog();
+    // Including the transactions left open by the script
+    while (m_document && m_document->isInTransaction())
+        m_document->commitTransaction();
 
+    const QString reason = interruption();
+    if (!reason.isEmpty()) {
+        QQmlError error;
+        error.setDescription(reason);
+        m_errors.push_back(error);
+        m_hasError = true;
+    }
+
+    m_engine->setInterrupted(false);
+    m_isRunning = false;
+    m_replay.reset();
     qDebug() << "<== End script";
+    emit finished();
+}
+
+bool ScriptRunner::isInterrupted()
+{
+    if (m_timeBudget > 0 && m_runTimer.elapsed() > m_timeBudget)
+        m_isOverBudget = true;
+    return m_isCancelled || m_isOverBudget;
+}
+
+QString ScriptRunner::interruption() const
+{
+    if (m_isCancelled)
+        return tr("Script cancelled");
+    if (m_isOverBudget)
+        return tr("Script stopped after its time budget of %1 ms").arg(m_timeBudget);
+    return {};
+}
+
+void ScriptRunner::runNextSlice()
+{
+    if (!m_replay)
+        return;
+
+    m_sliceTimer.start();
+    bool isDone = false;
+    while (!isDone && !isInterrupted() && m_sliceTimer.elapsed() < SliceDuration)
+        isDone = m_replay->run(m_document, m_replayState, SliceCalls);
+    emit progress(m_replayState.next, m_replay->size());
+
+    if (isDone || isInterrupted())
+        end();
+    else
+        QTimer::singleShot(0, this, &ScriptRunner::runNextSlice);
+}
+
+void ScriptRunner::startWorker(const QString &script)
+{
+    if (!m_workerThread) {
+        m_workerThread = std::make_unique<QThread>();
+        m_workerContext = new QObject;
+        m_workerContext->moveToThread(m_workerThread.get());
+        m_workerThread->start();
+    }
+
+    m_workerSnapshot = m_document->text();
+    const qsizetype position = m_document->position();
+    const qsizetype anchor = m_document->anchor();
+    const QString cacheDirectory = m_cacheDirectory;
+    startWatchdog();
+    QMetaObject::invokeMethod(m_workerContext, [this, script, position, anchor, cacheDirectory]() {
+        // Created in the worker thread, the headless document is the singleton of the worker QML engine
+        if (!m_workerDocument) {
+            m_workerDocument = std::make_unique<TextDocument>();
+            auto runner = new ScriptRunner(m_workerDocument.get());
+            QMutexLocker locker(&m_watchdogMutex);
+            m_workerRunner = runner;
+        }
+        m_workerRunner->setCacheDirectory(cacheDirectory);
+        m_workerDocument->setText(m_workerSnapshot);
+        m_workerDocument->setCursor(position, anchor);
+        // A cancellation before the run starts is forwarded again by the watchdog
+        if (!m_isCancelled && !m_isOverBudget)
+            m_workerRunner->runScript(script);
+
+        WorkerResult result {m_workerDocument->text(), m_workerDocument->position(), m_workerDocument->anchor(),
+                             m_workerRunner->hasError(), m_workerRunner->errors()};
+        QMetaObject::invokeMethod(this, [this, result]() {
+            finishWorker(result);
+        });
+    });
+}
+
+void ScriptRunner::finishWorker(const WorkerResult &result)
+{
+    // The interruption is reported by end()
+    if (!isInterrupted()) {
+        m_hasError = result.hasError;
+        m_errors = result.errors;
+    }
+    if (m_document->text() == m_workerSnapshot) {
+        m_document->applyText(result.text, result.position, result.anchor);
+    } else {
+        QQmlError error;
+        error.setDescription(tr("The document changed while the script was running, its result is discarded"));
+        m_errors.push_back(error);
+        m_hasError = true;
+    }
+    m_workerSnapshot.clear();
+    end();
+}
+
+void ScriptRunner::stopWorker()
+{
+    if (!m_workerThread)
+        return;
+    // Waits for the running script, if any
+    QMetaObject::invokeMethod(
+        m_workerContext,
+        [this]() {
+            ScriptRunner *runner = nullptr;
+            {
+                QMutexLocker locker(&m_watchdogMutex);
+                std::swap(runner, m_workerRunner);
+            }
+            delete runner;
+            m_workerDocument.reset();
+        },
+        Qt::BlockingQueuedConnection);
+    m_workerThread->quit();
+    m_workerThread->wait();
+    delete m_workerContext;
+    m_workerContext = nullptr;
+    m_workerThread.reset();
+}
+
+// The watchdog checks the cancellation and the time budget at regular intervals, and interrupts the javascript until
+// it stops: a run in the worker may not have started yet when cancelled
+void ScriptRunner::startWatchdog()
+{
+    const QDeadlineTimer deadline = m_timeBudget > 0
+        ? QDeadlineTimer(std::max<qint64>(0, m_timeBudget - m_runTimer.elapsed()))
+        : QDeadlineTimer(QDeadlineTimer::Forever);
+    m_isWatchdogStopped = false;
+    m_watchdog.reset(QThread::create([this, deadline]() {
+        QMutexLocker locker(&m_watchdogMutex);
+        while (!m_isWatchdogStopped) {
+            m_watchdogCondition.wait(&m_watchdogMutex, SliceDuration);
+            if (m_isWatchdogStopped)
+                return;
+            if (deadline.hasExpired())
+                m_isOverBudget = true;
+            if (m_isCancelled || m_isOverBudget)
+                interruptJavascript();
+        }
+    }));
+    m_watchdog->start();
+}
+
+void ScriptRunner::stopWatchdog()
+{
+    if (!m_watchdog)
+        return;
+    {
+        QMutexLocker locker(&m_watchdogMutex);
+        m_isWatchdogStopped = true;
+        m_watchdogCondition.wakeAll();
+    }
+    m_watchdog->wait();
+    m_watchdog.reset();
 }
 
 void ScriptRunner::runJavascript(const QString &script)
 {
+    const auto hoisted = scriptTemplate(script);
     const QString text = QStringLiteral("import QtQml 2.12\n"
                                         "import com.kdab.script 1.0\n"
-                                        "QtObject { function run() { %1 } }")
-                             .arg(script);
+                                        "QtObject { function run(%1) { %2 } }")
+                             .arg(hoisted ? LiteralsName : QString(), hoisted ? hoisted->text : script);
+
+    QQmlComponent *scriptComponent = component(text);
+    if (!scriptComponent) {
+        m_hasError = true;
+        return;
+    }
+
+    // The object is only needed for the run, so memory doesn't grow with the number of runs
+    std::unique_ptr<QObject> scriptObject(scriptComponent->create());
+    m_errors = scriptComponent->errors();
+    m_hasError = !scriptObject || scriptComponent->isError();
+    if (scriptObject) {
+        startWatchdog();
+        if (hoisted)
+            QMetaObject::invokeMethod(scriptObject.get(), "run", Q_ARG(QVariant, QVariant(hoisted->literals)));
+        else
+            QMetaObject::invokeMethod(scriptObject.get(), "run");
+        stopWatchdog();
+    }
+}
+
+QQmlComponent *ScriptRunner::component(const QString &text)
+{
+    const QByteArray source = text.toUtf8();
+    const QByteArray key = QCryptographicHash::hash(source, QCryptographicHash::Sha256);
+    if (auto cached = m_components.object(key))
+        return cached;
 
-    QQmlComponent component(m_engine);
-    component.setData(text.toLatin1(), {});
+    auto newComponent = std::make_unique<QQmlComponent>(m_engine);
+    bool isLoaded = false;
+    if (!m_cacheDirectory.isEmpty()) {
+        // Loaded from a file, so the QML disk cache saves its compilation unit in the application cache location and
+        // reuses it on next start. The access time of a file used again is updated, the least used ones are pruned: the
+        // modification time is left, it invalidates the compilation unit.
+        const QString fileName = QDir(m_cacheDirectory).filePath(QString::fromLatin1(key.toHex()) + ".qml");
+        if (QFile cached(fileName); cached.exists()) {
+            if (cached.open(QIODevice::ReadWrite))
+                cached.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileAccessTime);
+        } else {
+            QSaveFile file(fileName);
+            if (file.open(QIODevice::WriteOnly))
+                file.write(source);
+            if (!file.commit())
+                qWarning() << "Can't write the script cache file" << fileName;
+        }
+        if (QFile::exists(fileName)) {
+            newComponent->loadUrl(QUrl::fromLocalFile(fileName));
+            isLoaded = true;
+        }
+    }
+    if (!isLoaded)
+        newComponent->setData(source, {});
 
-    QObject *scriptObject = component.create();
-    m_errors = component.errors();
-    m_hasError = component.isError();
-    if (component.isReady() && !component.isError())
-        QMetaObject::invokeMethod(scriptObject, "run");
+    if (!newComponent->isReady()) {
+        m_errors = newComponent->errors();
+        return nullptr;
+    }
+    auto result = newComponent.get();
+    m_components.insert(key, newComponent.release());
+    return result;
 }
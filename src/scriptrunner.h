@@ -1,10 +1,22 @@
 #pragma once
 
+#include "nativereplay.h"
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QObject>
 #include <QQmlEngine>
 #include <QSharedPointer>
 #include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+#include <optional>
 
+class QQmlComponent;
+class QThread;
 class TextDocument;
 
 class ScriptRunner : public QObject
@@ -15,16 +27,117 @@ public:
     explicit ScriptRunner(TextDocument *document, QObject *parent = nullptr);
     ~ScriptRunner();
 
+    /**
+     * @brief Run a script on the document
+     * Straight-line scripts, as created from the history, are replayed natively, see NativeReplay. Other scripts are
+     * run by the QML engine. The script runs in a document transaction, so the view is updated once at the end.
+     */
     void runScript(const QString &script);
+    /**
+     * @brief Start running a script, without blocking the event loop
+     * Native replays are run in short slices from the event loop, in a document transaction. Javascript can't be
+     * split: it runs in a worker thread, on a headless copy of the document, and the result is applied to the document
+     * in one edit, even if the script is interrupted. Either way, the UI stays responsive and the script is stopped
+     * within a slice by cancel(). Emits finished at the end.
+     */
+    void start(const QString &script);
+    /**
+     * @brief Stop the running script, can be called from any thread
+     */
+    void cancel();
+    bool isRunning() const { return m_isRunning; }
+
+    /**
+     * @brief Maximum duration of a script in milliseconds, 0 for no limit
+     * A javascript script running for longer, even without calling the document, is interrupted by a watchdog thread,
+     * which also forwards the cancellation to the worker.
+     */
+    void setTimeBudget(int msec) { m_timeBudget = msec; }
+    int timeBudget() const { return m_timeBudget; }
 
     bool hasError() const { return m_hasError; }
     QList<QQmlError> errors() const { return m_errors; }
 
+    /**
+     * @brief Directory used to keep the compiled scripts between runs of the application
+     * Compiled components are cached in memory, keyed by the hash of the script with its literals moved to an array
+     * argument: scripts only differing by their literals share one component. With a cache directory, scripts are
+     * also saved there and loaded from the file, so the QML disk cache keeps their compilation units. The directory
+     * keeps the MaxCacheFiles scripts used last.
+     */
+    void setCacheDirectory(const QString &path);
+    QString cacheDirectory() const { return m_cacheDirectory; }
+    void clearCache();
+
+signals:
+    void started();
+    // Calls done by a native replay, out of totalCalls
+    void progress(int calls, int totalCalls);
+    void finished();
+
 private:
+    void begin();
+    void end();
+    bool isInterrupted();
+    QString interruption() const;
+
+    void runNextSlice();
+    void startWatchdog();
+    void stopWatchdog();
+    // Interrupt the running javascript, in this thread and in the worker, called with the watchdog mutex locked
+    void interruptJavascript();
+
+    struct WorkerResult
+    {
+        QString text;
+        qsizetype position = 0;
+        qsizetype anchor = 0;
+        bool hasError = false;
+        QList<QQmlError> errors;
+    };
+    void startWorker(const QString &script);
+    void finishWorker(const WorkerResult &result);
+    void stopWorker();
+
     void runJavascript(const QString &script);
+    QQmlComponent *component(const QString &text);
+
+    void pruneCacheDirectory();
+
+    static constexpr int ComponentCacheSize = 64;
+    static constexpr int MaxCacheFiles = 256;
+    // Time a native replay runs before processing events, and interval of the watchdog, in milliseconds
+    static constexpr int SliceDuration = 10;
+    static constexpr int SliceCalls = 256;
 
 private:
+    TextDocument *m_document = nullptr;
     bool m_hasError = false;
     QList<QQmlError> m_errors;
     QQmlEngine *m_engine = nullptr;
+    QCache<QByteArray, QQmlComponent> m_components {ComponentCacheSize};
+    QString m_cacheDirectory;
+
+    bool m_isRunning = false;
+    std::atomic_bool m_isCancelled = false;
+    std::atomic_bool m_isOverBudget = false;
+    int m_timeBudget = 0;
+    QElapsedTimer m_runTimer;
+    QElapsedTimer m_sliceTimer;
+    std::optional<NativeReplay> m_replay;
+    NativeReplay::State m_replayState;
+
+    // Worker thread running the javascript of start(), its document and runner are created and deleted there
+    std::unique_ptr<QThread> m_workerThread;
+    QObject *m_workerContext = nullptr;
+    std::unique_ptr<TextDocument> m_workerDocument;
+    ScriptRunner *m_workerRunner = nullptr;
+    // Text sent to the worker, the result is only applied if the document didn't change meanwhile
+    QString m_workerSnapshot;
+
+    std::unique_ptr<QThread> m_watchdog;
+    // Also guards m_workerRunner, which is used by the watchdog
+    QMutex m_watchdogMutex;
+    QWaitCondition m_watchdogCondition;
+    bool m_isWatchdogStopped = false;
 };
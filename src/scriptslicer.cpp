@@ -0,0 +1,19 @@
+#include "scriptslicer.h"
+#include "apisemantics.h"
+
+bool ScriptSlicer::addPrevious(ApiId apiId, const QStringList &argNames, const QString &returnName)
+{
+    const auto effects = ApiSemantics::effects(ApiSemantics::info(apiId).kind);
+    const bool isTarget = m_inputCalls++ == 0;
+    const bool definesVariable = !returnName.isEmpty() && m_neededVariables.remove(returnName);
+    if (!isTarget && !definesVariable && !(effects.writes & m_neededStates))
+        return false;
+
+    m_neededStates = (m_neededStates & ~effects.kills) | effects.reads;
+    for (const auto &name : argNames) {
+        if (!name.isEmpty())
+            m_neededVariables.insert(name);
+    }
+    ++m_outputCalls;
+    return true;
+}
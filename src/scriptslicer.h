@@ -0,0 +1,32 @@
+#pragma once
+
+#include "apiregistry.h"
+
+#include <QSet>
+#include <QStringList>
+
+/**
+ * @brief The ScriptSlicer class finds the calls a target call depends on, to reproduce it with a minimal script
+ *
+ * Calls are added backward, starting with the target call. A call is kept if it defines a variable used by a kept
+ * call, or if it changes a document state (text, cursor position or selection anchor) read by a kept call, see
+ * ApiSemantics::effects. Calls setting a state without reading it, like gotoStartOfDocument for the cursor, stop the
+ * dependency on that state. Unknown APIs are expected to read and change everything.
+ */
+class ScriptSlicer
+{
+public:
+    /**
+     * Add the call before the previous one added, returns true if it's part of the slice.
+     */
+    bool addPrevious(ApiId apiId, const QStringList &argNames, const QString &returnName);
+
+    int inputCalls() const { return m_inputCalls; }
+    int outputCalls() const { return m_outputCalls; }
+
+private:
+    int m_neededStates = 0;
+    QSet<QString> m_neededVariables;
+    int m_inputCalls = 0;
+    int m_outputCalls = 0;
+};
@@ -0,0 +1,93 @@
+#include "stringescape.h"
+
+#include <QtAlgorithms>
+
+// STRING_ESCAPE_NO_SIMD forces the scalar version, to test it against the SSE2 one
+#if defined(__SSE2__) && !defined(STRING_ESCAPE_NO_SIMD)
+#define STRING_ESCAPE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+bool isSpecial(char16_t c, EscapeMode mode)
+{
+    switch (c) {
+    case u'\n':
+    case u'\t':
+        return true;
+    case u'\\':
+    case u'"':
+        return mode == EscapeMode::Script;
+    default:
+        return false;
+    }
+}
+
+char16_t escapeLetter(char16_t c)
+{
+    switch (c) {
+    case u'\n':
+        return u'n';
+    case u'\t':
+        return u't';
+    default:
+        return c;
+    }
+}
+
+const char16_t *findSpecial(const char16_t *begin, const char16_t *end, EscapeMode mode)
+{
+    const char16_t *it = begin;
+#ifdef STRING_ESCAPE_SSE2
+    const __m128i newLine = _mm_set1_epi16(u'\n');
+    const __m128i tab = _mm_set1_epi16(u'\t');
+    const __m128i backslash = _mm_set1_epi16(u'\\');
+    const __m128i quote = _mm_set1_epi16(u'"');
+    const bool isScript = mode == EscapeMode::Script;
+
+    for (; end - it >= 8; it += 8) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi16(chars, newLine), _mm_cmpeq_epi16(chars, tab));
+        if (isScript) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi16(chars, backslash));
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi16(chars, quote));
+        }
+        // 2 bits per character
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(matches));
+        if (mask)
+            return it + qCountTrailingZeroBits(mask) / 2;
+    }
+#endif
+    for (; it != end; ++it) {
+        if (isSpecial(*it, mode))
+            return it;
+    }
+    return end;
+}
+
+} // namespace
+
+void appendEscaped(QString &output, QStringView text, EscapeMode mode)
+{
+    const char16_t *begin = text.utf16();
+    const char16_t *end = begin + text.size();
+    while (begin != end) {
+        const char16_t *special = findSpecial(begin, end, mode);
+        output.append(QStringView(begin, special));
+        if (special == end)
+            break;
+        const char16_t escape[] = {u'\\', escapeLetter(*special)};
+        output.append(QStringView(escape, 2));
+        begin = special + 1;
+    }
+}
+
+QString escaped(QStringView text, EscapeMode mode)
+{
+    // Most texts have few special characters
+    QString output;
+    output.reserve(text.size() + text.size() / 16 + 2);
+    appendEscaped(output, text, mode);
+    return output;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QString>
+
+enum class EscapeMode {
+    // New lines and tabulations, for display
+    Display,
+    // Backslashes, new lines, tabulations and double quotes, for a javascript string literal
+    Script,
+};
+
+/**
+ * @brief Append the text to output, with the special characters of the mode escaped
+ * The text is copied in one pass, by runs of characters between special characters, which are found 8 characters at a
+ * time using SSE2 when available.
+ */
+void appendEscaped(QString &output, QStringView text, EscapeMode mode);
+
+/**
+ * @brief Returns the text with the special characters of the mode escaped
+ */
+QString escaped(QStringView text, EscapeMode mode);
@@ -0,0 +1,60 @@
+#include "stringsearch.h"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+StringSearcher::StringSearcher(const QString &pattern)
+    : m_pattern(pattern)
+{
+}
+
+// The first and last characters are already known to match
+bool StringSearcher::matchesAt(const char16_t *text) const
+{
+    const qsizetype size = m_pattern.size();
+    return size <= 2 || std::memcmp(text + 1, m_pattern.utf16() + 1, (size - 2) * sizeof(char16_t)) == 0;
+}
+
+qsizetype StringSearcher::indexIn(QStringView text, qsizetype from) const
+{
+    const qsizetype size = m_pattern.size();
+    from = std::max<qsizetype>(from, 0);
+    if (size == 0)
+        return from <= text.size() ? from : -1;
+    if (text.size() - from < size)
+        return -1;
+
+    const char16_t *data = text.utf16();
+    const char16_t first = m_pattern.utf16()[0];
+    const char16_t last = m_pattern.utf16()[size - 1];
+    // Last position where the pattern can start
+    const qsizetype end = text.size() - size;
+    qsizetype i = from;
+#ifdef __SSE2__
+    const __m128i firsts = _mm_set1_epi16(static_cast<short>(first));
+    const __m128i lasts = _mm_set1_epi16(static_cast<short>(last));
+    for (; end - i >= 7; i += 8) {
+        const __m128i starts = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i ends = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + size - 1));
+        const __m128i candidates = _mm_and_si128(_mm_cmpeq_epi16(starts, firsts), _mm_cmpeq_epi16(ends, lasts));
+        // 2 bits per character
+        uint mask = static_cast<uint>(_mm_movemask_epi8(candidates));
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            if (matchesAt(data + i + bit / 2))
+                return i + bit / 2;
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+    for (; i <= end; ++i) {
+        if (data[i] == first && data[i + size - 1] == last && matchesAt(data + i))
+            return i;
+    }
+    return -1;
+}
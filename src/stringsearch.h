@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QString>
+
+/**
+ * @brief The StringSearcher class finds a pattern in texts, case sensitive
+ *
+ * Candidates are found 8 positions at a time using SSE2 when available: the first and last characters of the pattern
+ * are compared at once for 8 positions, and only the candidates matching both are compared in full. It's efficient on
+ * large texts, where the pattern is rare.
+ */
+class StringSearcher
+{
+public:
+    explicit StringSearcher(const QString &pattern);
+
+    const QString &pattern() const { return m_pattern; }
+
+    /**
+     * Returns the position of the first occurrence of the pattern at or after from, or -1.
+     */
+    qsizetype indexIn(QStringView text, qsizetype from = 0) const;
+
+private:
+    bool matchesAt(const char16_t *text) const;
+
+    QString m_pattern;
+};
@@ -1,13 +1,21 @@
 #include "textdocument.h"
 
 #include "logger.h"
+#include "piecetablebackend.h"
+#include "stringsearch.h"
+#include "texteditbackend.h"
 
+#include <QDebug>
 #include <QPlainTextEdit>
+#include <QRegularExpression>
 #include <private/qwidgettextcontrol_p.h>
 
+#include <algorithm>
+
 TextDocument::TextDocument(QPlainTextEdit *textEdit, QObject *parent)
     : QObject(parent)
     , m_document(textEdit)
+    , m_backend(std::make_unique<TextEditBackend>(textEdit))
 {
     LOG_REGISTER(TextDocument);
 
@@ -18,7 +26,88 @@ TextDocument::TextDocument(QPlainTextEdit *textEdit, QObject *parent)
     m_instance = this;
 }
 
-TextDocument::~TextDocument() = default;
+TextDocument::TextDocument(QObject *parent)
+    : QObject(parent)
+    , m_backend(std::make_unique<PieceTableBackend>())
+{
+    LOG_REGISTER(TextDocument);
+
+    m_backend->positionChanged = [this]() {
+        emit positionChanged();
+    };
+    m_backend->selectionChanged = [this]() {
+        emit selectionChanged();
+    };
+    m_instance = this;
+}
+
+TextDocument::~TextDocument()
+{
+    if (m_instance == this)
+        m_instance = nullptr;
+}
+
+QString TextDocument::text() const
+{
+    return m_backend->text();
+}
+
+void TextDocument::setText(const QString &text)
+{
+    m_backend->setText(text);
+}
+
+bool TextDocument::open(const QString &fileName)
+{
+    return m_backend->open(fileName);
+}
+
+bool TextDocument::save(QIODevice *device) const
+{
+    return m_backend->save(device);
+}
+
+void TextDocument::applyText(const QString &text, qsizetype position, qsizetype anchor)
+{
+    const QString current = m_backend->text();
+    const qsizetype common = std::min(current.size(), text.size());
+    qsizetype prefix = 0;
+    while (prefix < common && current[prefix] == text[prefix])
+        ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < common - prefix && current[current.size() - 1 - suffix] == text[text.size() - 1 - suffix])
+        ++suffix;
+    // Surrogate pairs aren't split
+    if (prefix > 0 && current[prefix - 1].isHighSurrogate())
+        --prefix;
+    if (suffix > 0 && current[current.size() - suffix].isLowSurrogate())
+        --suffix;
+
+    beginTransaction();
+    if (prefix + suffix < current.size() || prefix + suffix < text.size()) {
+        m_backend->setPosition(prefix);
+        m_backend->setPosition(current.size() - suffix, QTextCursor::KeepAnchor);
+        m_backend->insertText(text.sliced(prefix, text.size() - prefix - suffix));
+    }
+    setCursor(position, anchor);
+    commitTransaction();
+}
+
+void TextDocument::beginTransaction()
+{
+    if (m_transactionDepth++ == 0)
+        m_backend->beginTransaction();
+}
+
+void TextDocument::commitTransaction()
+{
+    if (m_transactionDepth == 0) {
+        qWarning() << "TextDocument::commitTransaction called without a transaction";
+        return;
+    }
+    if (--m_transactionDepth == 0)
+        m_backend->commitTransaction();
+}
 
 TextDocument *TextDocument::create(QQmlEngine *qmlEngine, QJSEngine *jsEngine)
 {
@@ -29,30 +118,45 @@ TextDocument *TextDocument::create(QQmlEngine *qmlEngine, QJSEngine *jsEngine)
 QString TextDocument::currentWord() const
 {
     LOG("TextDocument::currentWord");
-    QTextCursor cursor = m_document->textCursor();
-    cursor.movePosition(QTextCursor::StartOfWord);
-    cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-    LOG_RETURN("text", cursor.selectedText());
+    LOG_RETURN("text", m_backend->currentWord());
 }
 
 QString TextDocument::selectedText() const
 {
     LOG("TextDocument::selectedText");
-    // Replace \u2029 with \n
-    const QString text = m_document->textCursor().selectedText().replace(QChar(8233), "\n");
-    LOG_RETURN("text", text);
+    LOG_RETURN("text", m_backend->selectedText());
 }
 
 bool TextDocument::hasSelection() const
 {
-    return m_document->textCursor().hasSelection();
+    return m_backend->hasSelection();
+}
+
+qsizetype TextDocument::position() const
+{
+    return m_backend->position();
+}
+
+qsizetype TextDocument::anchor() const
+{
+    return m_backend->anchor();
+}
+
+void TextDocument::setCursor(qsizetype position, qsizetype anchor)
+{
+    m_backend->setPosition(anchor);
+    m_backend->setPosition(position, QTextCursor::KeepAnchor);
 }
 
 void TextDocument::movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode, int count)
 {
-    auto cursor = m_document->textCursor();
-    cursor.movePosition(operation, mode, count);
-    m_document->setTextCursor(cursor);
+    m_backend->movePosition(operation, mode, count);
+}
+
+void TextDocument::removeTo(QTextCursor::MoveOperation operation, int count)
+{
+    m_backend->movePosition(operation, QTextCursor::KeepAnchor, count);
+    m_backend->removeSelectedText();
 }
 
 void TextDocument::gotoStartOfLine()
@@ -130,15 +234,13 @@ void TextDocument::gotoEndOfDocument()
 void TextDocument::unselect()
 {
     LOG("TextDocument::unselect");
-    QTextCursor cursor = m_document->textCursor();
-    cursor.clearSelection();
-    m_document->setTextCursor(cursor);
+    m_backend->clearSelection();
 }
 
 void TextDocument::selectAll()
 {
     LOG("TextDocument::selectAll");
-    m_document->selectAll();
+    m_backend->selectAll();
 }
 
 void TextDocument::selectStartOfLine()
@@ -204,84 +306,275 @@ void TextDocument::selectNextWord(int count)
 void TextDocument::remove(int length)
 {
     LOG_AND_MERGE("TextDocument::remove", length);
-    QTextCursor cursor = m_document->textCursor();
-    cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    m_backend->setPosition(m_backend->position() + length, QTextCursor::KeepAnchor);
+    m_backend->removeSelectedText();
 }
 
 void TextDocument::insert(const QString &text)
 {
     LOG_AND_MERGE("TextDocument::insert", text);
-    m_document->insertPlainText(text);
+    m_backend->insertText(text);
 }
 
 void TextDocument::deleteSelection()
 {
     LOG("TextDocument::deleteSelection");
-    m_document->textCursor().removeSelectedText();
+    m_backend->removeSelectedText();
 }
 
 void TextDocument::deleteEndOfLine()
 {
     LOG("TextDocument::deleteEndOfLine");
-    QTextCursor cursor = m_document->textCursor();
-    cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    removeTo(QTextCursor::EndOfLine);
 }
 
 void TextDocument::deleteStartOfLine()
 {
     LOG("TextDocument::deleteStartOfLine");
-    QTextCursor cursor = m_document->textCursor();
-    cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    removeTo(QTextCursor::StartOfLine);
 }
 
 void TextDocument::deleteEndOfWord()
 {
     LOG("TextDocument::deleteEndOfWord");
-    QTextCursor cursor = m_document->textCursor();
-    if (!cursor.hasSelection())
-        cursor.movePosition(QTextCursor::NextWord, QTextCursor::KeepAnchor);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    if (m_backend->hasSelection())
+        m_backend->removeSelectedText();
+    else
+        removeTo(QTextCursor::NextWord);
 }
 
 void TextDocument::deleteStartOfWord()
 {
     LOG("TextDocument::deleteStartOfWord");
-    QTextCursor cursor = m_document->textCursor();
-    if (!cursor.hasSelection())
-        cursor.movePosition(QTextCursor::PreviousWord, QTextCursor::KeepAnchor);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    if (m_backend->hasSelection())
+        m_backend->removeSelectedText();
+    else
+        removeTo(QTextCursor::PreviousWord);
 }
 
 void TextDocument::deletePreviousCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deletePreviousCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
-    cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, count);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    removeTo(QTextCursor::PreviousCharacter, count);
 }
 
 void TextDocument::deleteNextCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deleteNextCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
-    cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, count);
-    cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    removeTo(QTextCursor::NextCharacter, count);
 }
 
 bool TextDocument::find(const QString &text)
 {
     LOG("TextDocument::find", LOG_ARG("text", text));
-    return m_document->find(text);
+    return m_backend->find(text);
+}
+
+QVariantList TextDocument::findAll(const QString &text, int flags)
+{
+    LOG("TextDocument::findAll", LOG_ARG("text", text), flags);
+    const auto found = matches(text, FindFlags(flags));
+    QVariantList result;
+    result.reserve(found.size());
+    for (const auto &match : found)
+        result.push_back(QVariantMap {{"start", match.start}, {"length", match.length}});
+    return result;
+}
+
+int TextDocument::count(const QString &text, int flags)
+{
+    LOG("TextDocument::count", LOG_ARG("text", text), flags);
+    LOG_RETURN("count", static_cast<int>(matches(text, FindFlags(flags)).size()));
+}
+
+static bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == u'_';
+}
+
+static bool isWholeWord(QStringView text, qsizetype start, qsizetype length)
+{
+    return (start == 0 || !isWordCharacter(text[start - 1]))
+        && (start + length == text.size() || !isWordCharacter(text[start + length]));
+}
+
+std::vector<TextDocument::Match> TextDocument::matches(const QString &text, FindFlags flags) const
+{
+    if (flags.testFlag(FindRegularExpression))
+        return findRegularExpression(m_backend->text(), text, flags);
+    return findText(text, flags);
+}
+
+std::vector<TextDocument::Match> TextDocument::findRegularExpression(const QString &snapshot, const QString &pattern,
+                                                                    FindFlags flags)
+{
+    std::vector<Match> result;
+    if (pattern.isEmpty())
+        return result;
+
+    const bool wholeWords = flags.testFlag(FindWholeWords);
+    const auto options = flags.testFlag(FindCaseSensitively) ? QRegularExpression::NoPatternOption
+                                                              : QRegularExpression::CaseInsensitiveOption;
+    QRegularExpression regexp(pattern, options);
+    if (!regexp.isValid()) {
+        qWarning() << "Invalid regular expression" << pattern << regexp.errorString();
+        return result;
+    }
+    auto it = regexp.globalMatch(snapshot);
+    while (it.hasNext()) {
+        const auto match = it.next();
+        if (!wholeWords || isWholeWord(snapshot, match.capturedStart(), match.capturedLength()))
+            result.push_back({match.capturedStart(), match.capturedLength(), match.capturedTexts()});
+    }
+    return result;
+}
+
+// The chunks are searched in a window, keeping the end of the previous chunks for the occurrences across chunks. An
+// occurrence is only added when the character after it is known, for the whole words.
+std::vector<TextDocument::Match> TextDocument::findText(const QString &text, FindFlags flags) const
+{
+    std::vector<Match> result;
+    if (text.isEmpty())
+        return result;
+
+    const bool isCaseSensitive = flags.testFlag(FindCaseSensitively);
+    const bool wholeWords = flags.testFlag(FindWholeWords);
+    const QString pattern = isCaseSensitive ? text : text.toCaseFolded();
+    const StringSearcher searcher(pattern);
+
+    QString window;
+    qsizetype windowStart = 0;
+    // First position where an occurrence can start
+    qsizetype next = 0;
+    auto search = [&](bool isLast) {
+        // Case folding keeps the positions, except for a few characters, searched without the fast path
+        const QString folded = isCaseSensitive ? QString() : window.toCaseFolded();
+        const bool isFolded = !isCaseSensitive && folded.size() == window.size() && pattern.size() == text.size();
+        auto indexOf = [&](qsizetype from) {
+            if (isCaseSensitive)
+                return searcher.indexIn(window, from);
+            if (isFolded)
+                return searcher.indexIn(folded, from);
+            return window.indexOf(text, from, Qt::CaseInsensitive);
+        };
+
+        const qsizetype limit = isLast ? window.size() : window.size() - 1;
+        for (qsizetype found = indexOf(next - windowStart); found != -1 && found + text.size() <= limit;) {
+            if (wholeWords && !isWholeWord(window, found, text.size())) {
+                next = windowStart + found + 1;
+                found = indexOf(found + 1);
+                continue;
+            }
+            result.push_back({windowStart + found, text.size(), {}});
+            next = windowStart + found + text.size();
+            found = indexOf(found + text.size());
+        }
+
+        // Keep the text that can start an occurrence, and the character before it
+        next = std::max(next, windowStart + limit - text.size() + 1);
+        const qsizetype removed = std::clamp<qsizetype>(next - windowStart - 1, 0, window.size());
+        window.remove(0, removed);
+        windowStart += removed;
+    };
+
+    m_backend->forEachChunk(0, [&](qsizetype, QStringView chunk) {
+        window.append(chunk);
+        search(false);
+        return true;
+    });
+    search(true);
+    return result;
+}
+
+namespace {
+
+// Part of a replacement: a literal text, or a captured text
+struct ReplacementPart
+{
+    QString text;
+    int capture = -1;
+};
+
+// \1 to \99 are captured texts, other characters are copied
+std::vector<ReplacementPart> parseReplacement(const QString &replacement, bool hasCaptures)
+{
+    std::vector<ReplacementPart> parts(1);
+    for (qsizetype i = 0; i < replacement.size(); ++i) {
+        if (hasCaptures && replacement[i] == u'\\' && i + 1 < replacement.size() && replacement[i + 1].isDigit()) {
+            int capture = replacement[++i].digitValue();
+            if (i + 1 < replacement.size() && replacement[i + 1].isDigit())
+                capture = capture * 10 + replacement[++i].digitValue();
+            parts.push_back({{}, capture});
+            parts.push_back({});
+            continue;
+        }
+        parts.back().text.append(replacement[i]);
+    }
+    return parts;
+}
+
+// Position of a cursor after the replacement of the text between start and end
+qsizetype mapPosition(qsizetype position, qsizetype start, qsizetype end, qsizetype newEnd)
+{
+    if (position <= start)
+        return position;
+    if (position >= end)
+        return position + newEnd - end;
+    return newEnd;
+}
+
+} // namespace
+
+int TextDocument::replaceAll(const QString &pattern, const QString &replacement, int flags)
+{
+    LOG("TextDocument::replaceAll", LOG_ARG("pattern", pattern), LOG_ARG("replacement", replacement), flags);
+
+    const bool isRegularExpression = FindFlags(flags).testFlag(FindRegularExpression);
+    // A plain pattern is searched chunk by chunk, only a regular expression needs the whole text
+    const QString snapshot = isRegularExpression ? m_backend->text() : QString();
+    const auto found = isRegularExpression ? findRegularExpression(snapshot, pattern, FindFlags(flags))
+                                           : findText(pattern, FindFlags(flags));
+    if (found.empty())
+        LOG_RETURN("count", 0);
+
+    // Only the text from the first to the last occurrence is read and replaced. The text between the occurrences is
+    // the raw text of the backend, not the searched one, so its non-breaking spaces and line separators are kept.
+    const auto parts = parseReplacement(replacement, isRegularExpression);
+    const qsizetype start = found.front().start;
+    const qsizetype end = found.back().start + found.back().length;
+    const QString range = m_backend->text(start, end);
+    const QStringView replaced(range);
+    QString text;
+    // Regular expression matches and captures have unknown lengths, the text grows as needed
+    if (!isRegularExpression) {
+        const qsizetype growth = std::max<qsizetype>(replacement.size() - pattern.size(), 0);
+        text.reserve(end - start + static_cast<qsizetype>(found.size()) * growth);
+    }
+    qsizetype copied = start;
+    for (const auto &match : found) {
+        text.append(replaced.sliced(copied - start, match.start - copied));
+        for (const auto &part : parts) {
+            if (part.capture >= 0 && part.capture < match.captures.size())
+                text.append(match.captures[part.capture]);
+            else
+                text.append(part.text);
+        }
+        copied = match.start + match.length;
+    }
+
+    // One edit, the cursor and selection are notified once
+    const qsizetype position = m_backend->position();
+    const qsizetype anchor = m_backend->anchor();
+    beginTransaction();
+    m_backend->setPosition(start);
+    m_backend->setPosition(end, QTextCursor::KeepAnchor);
+    m_backend->insertText(text);
+    const qsizetype newEnd = start + text.size();
+    m_backend->setPosition(mapPosition(anchor, start, end, newEnd));
+    m_backend->setPosition(mapPosition(position, start, end, newEnd), QTextCursor::KeepAnchor);
+    commitTransaction();
+
+    LOG_RETURN("count", static_cast<int>(found.size()));
 }
 
 void TextDocument::foo()
@@ -343,11 +636,11 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::MoveToPreviousPage)
             return false;
         else if (keyEvent == QKeySequence::Delete)
-            m_document->textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
+            m_backend->hasSelection() ? deleteSelection() : deleteNextCharacter();
         else if (keyEvent == QKeySequence::Backspace
                  || (keyEvent->key() == Qt::Key_Backspace
                      && !(keyEvent->modifiers() & ~Qt::ShiftModifier))) // test is coming from QTextWidgetControl
-            m_document->textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
+            m_backend->hasSelection() ? deleteSelection() : deletePreviousCharacter();
         else if (keyEvent == QKeySequence::InsertParagraphSeparator)
             insert("\n");
         else if (keyEvent == QKeySequence::InsertLineSeparator)
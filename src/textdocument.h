@@ -1,10 +1,15 @@
 #pragma once
 
+#include "documentbackend.h"
+
 #include <QObject>
 #include <QPointer>
 #include <QTextCursor>
 #include <QQmlEngine>
 
+#include <memory>
+#include <vector>
+
 class QPlainTextEdit;
 
 class TextDocument : public QObject
@@ -17,7 +22,29 @@ class TextDocument : public QObject
     Q_PROPERTY(QString selectedText READ selectedText NOTIFY selectionChanged)
 
 public:
+    enum FindFlag {
+        FindCaseSensitively = 0x1,
+        FindWholeWords = 0x2,
+        FindRegularExpression = 0x4,
+    };
+    Q_DECLARE_FLAGS(FindFlags, FindFlag)
+    Q_FLAG(FindFlags)
+
+    struct Match
+    {
+        qsizetype start;
+        qsizetype length;
+        // Captured texts of a regular expression, the first one is the whole match
+        QStringList captures;
+    };
+
     TextDocument(QPlainTextEdit *textEdit, QObject *parent = nullptr);
+    /**
+     * @brief Create a headless text document, stored in a piece table without any layout
+     * Unlike the QPlainTextEdit version, it can be used in any thread. There is one instance per thread, used as the
+     * singleton of the QML engines of that thread.
+     */
+    explicit TextDocument(QObject *parent = nullptr);
     ~TextDocument();
 
     static TextDocument *create(QQmlEngine *qmlEngine, QJSEngine *jsEngine);
@@ -27,6 +54,35 @@ public:
     QString currentWord() const;
     QString selectedText() const;
     bool hasSelection() const;
+    // Cursor of the document, not recorded in the history
+    qsizetype position() const;
+    qsizetype anchor() const;
+    void setCursor(qsizetype position, qsizetype anchor);
+
+    // Whole text of the document, not recorded in the history
+    QString text() const;
+    void setText(const QString &text);
+    /**
+     * @brief Open a UTF-8 file, not recorded in the history
+     * A headless document maps the file: it can be used as soon as it's open, the lines are indexed in the background.
+     */
+    bool open(const QString &fileName);
+    bool save(QIODevice *device) const;
+    /**
+     * @brief Replace the text and the cursor with the result of a script run on a copy of the document
+     * Only the range between the common start and end of both texts is edited, in one transaction. Not recorded in the
+     * history.
+     */
+    void applyText(const QString &text, qsizetype position, qsizetype anchor);
+
+    /**
+     * @brief Returns all occurrences of the text, not overlapping, not recorded in the history
+     * A plain text is searched chunk by chunk, so a mapped file isn't read in one string. The text is a regular
+     * expression with FindRegularExpression, matched on a snapshot of the whole text.
+     */
+    std::vector<Match> matches(const QString &text, FindFlags flags) const;
+
+    bool isInTransaction() const { return m_transactionDepth > 0; }
 
 signals:
     void positionChanged();
@@ -72,6 +128,29 @@ public slots:
     void deleteNextCharacter(int count = 1);
 
     bool find(const QString &text);
+    /**
+     * @brief Returns all occurrences of the text, as a list of {start, length} objects
+     * Flags are a combination of FindFlag. The cursor doesn't move.
+     */
+    QVariantList findAll(const QString &text, int flags = 0);
+    int count(const QString &text, int flags = 0);
+    /**
+     * @brief Replace all occurrences of the pattern, returns the number of replacements
+     * The new text is built in one pass from the first to the last occurrence, and applied as one edit. The text
+     * between the occurrences is copied as stored, with its non-breaking spaces and line separators. With
+     * FindRegularExpression, \1 to \99 in the replacement are the captured texts. The cursor and selection stay on
+     * the same text.
+     */
+    int replaceAll(const QString &pattern, const QString &replacement, int flags = 0);
+
+    /**
+     * @brief Group the following edits in one transaction, until commitTransaction
+     * All edits of a transaction are one undo step, and the layout is done once. The view isn't updated, and the
+     * positionChanged and selectionChanged signals aren't emitted until the commit. Transactions can be nested, only
+     * the outermost one is committed. Transactions aren't recorded in the history.
+     */
+    void beginTransaction();
+    void commitTransaction();
 
     void foo();
     void bar();
@@ -79,7 +158,17 @@ public slots:
 private:
     void movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode = QTextCursor::MoveAnchor,
                       int count = 1);
+    std::vector<Match> findText(const QString &text, FindFlags flags) const;
+    static std::vector<Match> findRegularExpression(const QString &snapshot, const QString &pattern, FindFlags flags);
 
+    // Select from the cursor with the move, and delete the selection
+    void removeTo(QTextCursor::MoveOperation operation, int count = 1);
+
+    // Only used with a QPlainTextEdit, to record the key presses
     QPointer<QPlainTextEdit> m_document;
-    inline static TextDocument *m_instance;
+    std::unique_ptr<DocumentBackend> m_backend;
+    int m_transactionDepth = 0;
+    inline static thread_local TextDocument *m_instance = nullptr;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(TextDocument::FindFlags)
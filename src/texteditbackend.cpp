@@ -0,0 +1,181 @@
+#include "texteditbackend.h"
+
+#include <QFile>
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include <algorithm>
+#include <limits>
+
+TextEditBackend::TextEditBackend(QPlainTextEdit *textEdit)
+    : m_textEdit(textEdit)
+{
+    Q_ASSERT(textEdit);
+}
+
+QTextCursor TextEditBackend::cursor() const
+{
+    return m_isInTransaction ? m_cursor : m_textEdit->textCursor();
+}
+
+void TextEditBackend::setCursor(const QTextCursor &cursor)
+{
+    if (m_isInTransaction)
+        m_cursor = cursor;
+    else
+        m_textEdit->setTextCursor(cursor);
+}
+
+QString TextEditBackend::text() const
+{
+    return m_textEdit->toPlainText();
+}
+
+QString TextEditBackend::text(qsizetype from, qsizetype to) const
+{
+    // The raw text of the blocks: unlike text() and the chunks, the non-breaking spaces and line separators are kept,
+    // so the range can be edited back without changing them
+    QString result;
+    from = std::clamp<qsizetype>(from, 0, std::numeric_limits<int>::max());
+    if (to <= from)
+        return result;
+    for (QTextBlock block = m_textEdit->document()->findBlock(static_cast<int>(from)); block.isValid();
+         block = block.next()) {
+        const qsizetype offset = std::max<qsizetype>(from - block.position(), 0);
+        const QString text = block.text();
+        result.append(QStringView(text).sliced(std::min(offset, text.size())));
+        if (block.next().isValid())
+            result.append(u'\n');
+        if (block.position() + text.size() + 1 >= to)
+            break;
+    }
+    result.truncate(to - from);
+    return result;
+}
+
+void TextEditBackend::forEachChunk(qsizetype from, const ChunkFunction &function) const
+{
+    // A QTextDocument can't be larger than an int
+    from = std::clamp<qsizetype>(from, 0, std::numeric_limits<int>::max());
+    for (QTextBlock block = m_textEdit->document()->findBlock(static_cast<int>(from)); block.isValid();
+         block = block.next()) {
+        QString text = block.text();
+        text.replace(QChar::LineSeparator, u'\n').replace(QChar::Nbsp, u' ');
+        if (block.next().isValid())
+            text.append(u'\n');
+        const qsizetype offset = std::max<qsizetype>(from - block.position(), 0);
+        if (!function(block.position() + offset, QStringView(text).sliced(offset)))
+            return;
+    }
+}
+
+void TextEditBackend::setText(const QString &text)
+{
+    m_textEdit->setPlainText(text);
+    if (m_isInTransaction)
+        m_cursor = m_textEdit->textCursor();
+}
+
+// The view needs the whole text in its QTextDocument
+bool TextEditBackend::open(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    setText(QString::fromUtf8(file.readAll()));
+    return true;
+}
+
+bool TextEditBackend::save(QIODevice *device) const
+{
+    return device->write(text().toUtf8()) >= 0;
+}
+
+QString TextEditBackend::selectedText() const
+{
+    // Replace the paragraph separators (\u2029) with \n
+    return cursor().selectedText().replace(QChar::ParagraphSeparator, u'\n');
+}
+
+QString TextEditBackend::currentWord() const
+{
+    QTextCursor wordCursor = cursor();
+    wordCursor.movePosition(QTextCursor::StartOfWord);
+    wordCursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
+    return wordCursor.selectedText();
+}
+
+void TextEditBackend::movePosition(MoveOperation operation, MoveMode mode, int count)
+{
+    auto moved = cursor();
+    moved.movePosition(operation, mode, count);
+    setCursor(moved);
+}
+
+void TextEditBackend::setPosition(qsizetype position, MoveMode mode)
+{
+    auto moved = cursor();
+    moved.setPosition(static_cast<int>(std::min<qsizetype>(position, std::numeric_limits<int>::max())), mode);
+    setCursor(moved);
+}
+
+void TextEditBackend::selectAll()
+{
+    auto selection = cursor();
+    selection.select(QTextCursor::Document);
+    setCursor(selection);
+}
+
+void TextEditBackend::clearSelection()
+{
+    auto unselected = cursor();
+    unselected.clearSelection();
+    setCursor(unselected);
+}
+
+void TextEditBackend::insertText(const QString &text)
+{
+    if (m_isInTransaction)
+        m_cursor.insertText(text);
+    else
+        m_textEdit->insertPlainText(text);
+}
+
+void TextEditBackend::removeSelectedText()
+{
+    auto edited = cursor();
+    edited.removeSelectedText();
+    setCursor(edited);
+}
+
+bool TextEditBackend::find(const QString &text)
+{
+    if (!m_isInTransaction)
+        return m_textEdit->find(text);
+    const QTextCursor found = m_textEdit->document()->find(text, m_cursor);
+    if (found.isNull())
+        return false;
+    m_cursor = found;
+    return true;
+}
+
+void TextEditBackend::beginTransaction()
+{
+    Q_ASSERT(!m_isInTransaction);
+    m_cursor = m_textEdit->textCursor();
+    m_textEdit->viewport()->setUpdatesEnabled(false);
+    m_cursor.beginEditBlock();
+    m_isInTransaction = true;
+}
+
+void TextEditBackend::commitTransaction()
+{
+    Q_ASSERT(m_isInTransaction);
+    m_isInTransaction = false;
+    m_cursor.endEditBlock();
+    m_textEdit->setTextCursor(m_cursor);
+    m_cursor = {};
+    m_textEdit->viewport()->setUpdatesEnabled(true);
+    m_textEdit->ensureCursorVisible();
+}
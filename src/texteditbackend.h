@@ -0,0 +1,55 @@
+#pragma once
+
+#include "documentbackend.h"
+
+#include <QPointer>
+
+class QPlainTextEdit;
+
+/**
+ * @brief The TextEditBackend class is the DocumentBackend of a QPlainTextEdit, for interactive use
+ *
+ * The cursor is the cursor of the view, which sends its own notifications. During a transaction, edits are done with a
+ * separate cursor of the same document, and the view is only updated on commit.
+ */
+class TextEditBackend : public DocumentBackend
+{
+public:
+    explicit TextEditBackend(QPlainTextEdit *textEdit);
+
+    QString text() const override;
+    QString text(qsizetype from, qsizetype to) const override;
+    /**
+     * The chunks are the blocks of the QTextDocument, with the characters of toPlainText().
+     */
+    void forEachChunk(qsizetype from, const ChunkFunction &function) const override;
+    void setText(const QString &text) override;
+    bool open(const QString &fileName) override;
+    bool save(QIODevice *device) const override;
+
+    qsizetype position() const override { return cursor().position(); }
+    qsizetype anchor() const override { return cursor().anchor(); }
+    QString selectedText() const override;
+    QString currentWord() const override;
+
+    void movePosition(MoveOperation operation, MoveMode mode, int count) override;
+    void setPosition(qsizetype position, MoveMode mode) override;
+    void selectAll() override;
+    void clearSelection() override;
+
+    void insertText(const QString &text) override;
+    void removeSelectedText() override;
+    bool find(const QString &text) override;
+
+    void beginTransaction() override;
+    void commitTransaction() override;
+
+private:
+    QTextCursor cursor() const;
+    void setCursor(const QTextCursor &cursor);
+
+    QPointer<QPlainTextEdit> m_textEdit;
+    // Cursor used during a transaction
+    QTextCursor m_cursor;
+    bool m_isInTransaction = false;
+};
@@ -1,11 +1,17 @@
 #include "widget.h"
+#include "historyfiltermodel.h"
 #include "historymodel.h"
 #include "logger.h"
 #include "scriptrunner.h"
 #include "textdocument.h"
 #include "ui_widget.h"
 
+#include <QDebug>
+#include <QDir>
+#include <QFileDialog>
+#include <QLockFile>
 #include <QShortcut>
+#include <QStandardPaths>
 
 Widget::Widget(QWidget *parent)
     : QWidget(parent)
@@ -15,8 +21,36 @@ Widget::Widget(QWidget *parent)
     s_debugView = ui->debugView;
     m_document.reset(new TextDocument(ui->editor));
     m_scritpRunner.reset(new ScriptRunner(m_document.get()));
+    m_scritpRunner->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/scripts");
 
     connect(ui->runButton, &QToolButton::clicked, this, &Widget::run);
+    connect(ui->stopButton, &QToolButton::clicked, m_scritpRunner.get(), &ScriptRunner::cancel);
+
+    // The editor is disabled while a script runs, the progress is busy until the number of calls is known
+    m_scritpRunner->setTimeBudget(60 * 1000);
+    ui->runProgress->hide();
+    connect(m_scritpRunner.get(), &ScriptRunner::started, this, [this]() {
+        ui->runButton->setEnabled(false);
+        ui->stopButton->setEnabled(true);
+        ui->editor->setEnabled(false);
+        ui->runProgress->setRange(0, 0);
+        ui->runProgress->show();
+    });
+    connect(m_scritpRunner.get(), &ScriptRunner::progress, this, [this](int calls, int totalCalls) {
+        if (totalCalls < 0)
+            return;
+        ui->runProgress->setRange(0, totalCalls);
+        ui->runProgress->setValue(calls);
+    });
+    connect(m_scritpRunner.get(), &ScriptRunner::finished, this, [this]() {
+        ui->runButton->setEnabled(true);
+        ui->stopButton->setEnabled(false);
+        ui->editor->setEnabled(true);
+        ui->editor->setFocus();
+        ui->runProgress->hide();
+        for (const auto &error : m_scritpRunner->errors())
+            qWarning() << error.toString();
+    });
     connect(ui->findNextButton, &QToolButton::clicked, this, &Widget::find);
 
     auto fooShortcut = new QShortcut(QKeySequence("Alt+F"), this);
@@ -24,25 +58,84 @@ Widget::Widget(QWidget *parent)
     auto barShortcut = new QShortcut(QKeySequence("Alt+B"), this);
     connect(barShortcut, &QShortcut::activated, m_document.get(), &TextDocument::bar);
 
+    auto openFileShortcut = new QShortcut(QKeySequence::Open, this);
+    connect(openFileShortcut, &QShortcut::activated, this, &Widget::openFile);
+
     auto openFindShortcut = new QShortcut(QKeySequence("Ctrl+F"), this);
     connect(openFindShortcut, &QShortcut::activated, this, &Widget::openFind);
     auto closeFindShortcut = new QShortcut(QKeySequence(Qt::Key_Escape), this);
     connect(closeFindShortcut, &QShortcut::activated, this, &Widget::closeFind);
 
     auto historyModel = new HistoryModel(this);
-    ui->historyView->setModel(historyModel);
+    const QString dataLocation = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    // Only one instance writes the journal and the archive, the other ones keep their history in memory. The lock is
+    // released once the model is destroyed, after closing its files.
+    auto historyLock = new QLockFile(dataLocation + "/history.lock");
+    connect(historyModel, &QObject::destroyed, [historyLock]() { delete historyLock; });
+    if (QDir().mkpath(dataLocation) && historyLock->tryLock()) {
+        historyModel->openJournal(dataLocation + "/history.journal");
+        historyModel->openArchive(dataLocation + "/history.archive");
+    } else {
+        qWarning() << "The history is already used by another instance, it's not saved";
+    }
+    historyModel->setMaxBytes(64 * 1024 * 1024);
+    auto filterModel = new HistoryFilterModel(historyModel, this);
+    ui->historyView->setModel(filterModel);
     ui->historyView->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    auto showLast = [this, historyModel]() {
-        ui->historyView->scrollTo(historyModel->index(historyModel->rowCount() - 1, 0));
+    auto showLast = [this, filterModel]() {
+        ui->historyView->scrollTo(filterModel->index(filterModel->rowCount() - 1, 0));
+    };
+    connect(filterModel, &QAbstractItemModel::rowsInserted, this, showLast);
+
+    // The filter is "api", "api:text" or ":text"
+    auto filterHistory = [filterModel](const QString &text) {
+        HistoryModel::Filter filter;
+        const auto separator = text.indexOf(':');
+        filter.apiName = text.left(separator).trimmed();
+        if (separator != -1)
+            filter.text = text.mid(separator + 1);
+        filterModel->setFilter(filter);
     };
-    connect(historyModel, &QAbstractItemModel::rowsInserted, this, showLast);
+    connect(ui->historyFilterEdit, &QLineEdit::textChanged, this, filterHistory);
 
-    auto createScriptFromSelection = [this, historyModel]() {
+    // The selection is in the filtered view, the script is created from the first to the last row selected
+    auto selectedRows = [this, filterModel]() -> std::pair<int, int> {
         auto selection = ui->historyView->selectionModel()->selectedIndexes();
-        ui->script->setPlainText(historyModel->createScript(selection.first(), selection.last()));
+        if (selection.isEmpty())
+            return {-1, -1};
+        return {filterModel->mapToSource(selection.first()).row(), filterModel->mapToSource(selection.last()).row()};
+    };
+
+    auto createScriptFromSelection = [this, historyModel, selectedRows]() {
+        const auto [first, last] = selectedRows();
+        if (first != -1)
+            ui->script->setPlainText(historyModel->createScript(first, last));
     };
     connect(ui->createButton, &QToolButton::clicked, this, createScriptFromSelection);
 
+    // The calls before the selection are also used, to reproduce the last row selected from the whole history
+    auto createSliceFromSelection = [this, historyModel, selectedRows]() {
+        const auto [first, last] = selectedRows();
+        if (first == -1)
+            return;
+        const auto options = HistoryModel::DefaultScriptOptions | HistoryModel::SliceScript;
+        ui->script->setPlainText(historyModel->createScript(-historyModel->archivedRows(), last, options));
+    };
+    connect(ui->sliceButton, &QToolButton::clicked, this, createSliceFromSelection);
+
+    auto exportScriptFromSelection = [this, historyModel, selectedRows]() {
+        const auto [first, last] = selectedRows();
+        if (first == -1)
+            return;
+        const QString fileName = QFileDialog::getSaveFileName(this, tr("Export Script"), {}, tr("Scripts (*.js)"));
+        if (fileName.isEmpty())
+            return;
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || !historyModel->writeScript(first, last, &file))
+            qWarning() << "Can't export the script to" << fileName;
+    };
+    connect(ui->exportButton, &QToolButton::clicked, this, exportScriptFromSelection);
+
     auto cleanAll = [this, historyModel]() {
         ui->debugView->clear();
         historyModel->clear();
@@ -61,7 +154,16 @@ Widget::~Widget()
 void Widget::run()
 {
     const auto &script = ui->script->toPlainText();
-    m_scritpRunner->runScript(script);
+    m_scritpRunner->start(script);
+}
+
+void Widget::openFile()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"));
+    if (fileName.isEmpty())
+        return;
+    if (!m_document->open(fileName))
+        qWarning() << "Can't open" << fileName;
 }
 
 void Widget::openFind()
@@ -21,6 +21,7 @@ public:
     ~Widget();
 
     void run();
+    void openFile();
     void openFind();
     void closeFind();
     void find();
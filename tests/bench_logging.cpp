@@ -0,0 +1,49 @@
+#include "historymodel.h"
+#include "logger.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+/**
+ * @brief Cost of a logged API, with the history recording, with logging off, and with logging compiled out
+ * The compiled out case is the bench_logging_disabled target, built from the same file with API_LOGGING_DISABLED.
+ */
+class LoggingBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void gotoNextChar_data();
+    void gotoNextChar();
+};
+
+void LoggingBenchmark::gotoNextChar_data()
+{
+    QTest::addColumn<int>("level");
+#ifdef API_LOGGING_DISABLED
+    QTest::newRow("compiled out") << static_cast<int>(LoggerObject::Level::Record);
+#else
+    QTest::newRow("recording") << static_cast<int>(LoggerObject::Level::Record);
+    QTest::newRow("off") << static_cast<int>(LoggerObject::Level::Off);
+#endif
+}
+
+void LoggingBenchmark::gotoNextChar()
+{
+    QFETCH(int, level);
+    LoggerObject::setLevel(static_cast<LoggerObject::Level>(level));
+
+    HistoryModel model;
+    TextDocument document;
+    document.setText(QString(1024, u'a'));
+
+    // The moves are merged in one history row while recording
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i)
+            document.gotoNextChar();
+        document.setText(QString(1024, u'a'));
+    }
+}
+
+QTEST_MAIN(LoggingBenchmark)
+#include "bench_logging.moc"
@@ -0,0 +1,60 @@
+#include "stringescape.h"
+
+#include <QTest>
+
+/**
+ * @brief Cost of escaping a script string, with a single pass and with the replace() chain it replaced
+ */
+class StringEscapeBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString replaceChain(QString text)
+    {
+        text.replace('\\', R"(\\)");
+        text.replace('\n', R"(\n)");
+        text.replace('\t', R"(\t)");
+        text.replace('"', R"(\")");
+        return text;
+    }
+
+    static void addRows()
+    {
+        QTest::addColumn<QString>("text");
+
+        const QString line = "    document.insert(\"some text\");\n";
+        QTest::newRow("short") << QString("hello");
+        QTest::newRow("plain") << QString(64 * 1024, u'a');
+        QTest::newRow("code") << line.repeated(64 * 1024 / line.size());
+        QTest::newRow("specials") << QString("\"\\\n\t").repeated(16 * 1024);
+    }
+
+private slots:
+    void singlePass_data() { addRows(); }
+    void singlePass();
+    void replace_data() { addRows(); }
+    void replace();
+};
+
+void StringEscapeBenchmark::singlePass()
+{
+    QFETCH(QString, text);
+    QString result;
+    QBENCHMARK {
+        result = escaped(text, EscapeMode::Script);
+    }
+    QCOMPARE(result, replaceChain(text));
+}
+
+void StringEscapeBenchmark::replace()
+{
+    QFETCH(QString, text);
+    QString result;
+    QBENCHMARK {
+        result = replaceChain(text);
+    }
+}
+
+QTEST_MAIN(StringEscapeBenchmark)
+#include "bench_stringescape.moc"
@@ -0,0 +1,96 @@
+#include "batchrunner.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestBatchRunner : public QObject
+{
+    Q_OBJECT
+
+private:
+    static std::vector<BatchRunner::Job> createJobs(const QTemporaryDir &directory, int count)
+    {
+        const QDir dir(directory.path());
+        std::vector<BatchRunner::Job> jobs;
+        for (int i = 0; i < count; ++i) {
+            const QString input = dir.filePath(QString("input/%1.txt").arg(i));
+            QDir().mkpath(QFileInfo(input).absolutePath());
+            QFile file(input);
+            if (file.open(QIODevice::WriteOnly))
+                file.write(QByteArray::number(i));
+            jobs.push_back({input, dir.filePath(QString("output/%1.txt").arg(i))});
+        }
+        return jobs;
+    }
+
+    static QByteArray readAll(const QString &fileName)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+private slots:
+    void run_data();
+    void run();
+    void timeout();
+    void outputCollisions();
+};
+
+void TestBatchRunner::run_data()
+{
+    QTest::addColumn<int>("workers");
+    QTest::addColumn<int>("jobs");
+
+    QTest::newRow("one worker") << 1 << 5;
+    QTest::newRow("more workers than jobs") << 4 << 2;
+    QTest::newRow("stolen jobs") << 3 << 20;
+}
+
+// All jobs are run once, whichever worker takes them
+void TestBatchRunner::run()
+{
+    QFETCH(int, workers);
+    QFETCH(int, jobs);
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    auto batchJobs = createJobs(directory, jobs);
+    const auto expectedJobs = batchJobs;
+
+    BatchRunner runner("TextDocument.gotoEndOfDocument();\nTextDocument.insert(\"!\");\n", workers);
+    const auto result = runner.run(std::move(batchJobs));
+    QCOMPARE(result.succeeded, jobs);
+    QCOMPARE(result.failed, 0);
+    for (int i = 0; i < jobs; ++i)
+        QCOMPARE(readAll(expectedJobs[i].outputFile), QByteArray::number(i) + '!');
+}
+
+// A job over its time budget fails, the other ones go on
+void TestBatchRunner::timeout()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    auto jobs = createJobs(directory, 3);
+    const auto expectedJobs = jobs;
+
+    BatchRunner runner("if (TextDocument.count(\"1\") > 0) { while (true) {} }\nTextDocument.insert(\"x\");\n", 2);
+    runner.setTimeBudget(100);
+    const auto result = runner.run(std::move(jobs));
+    QCOMPARE(result.succeeded, 2);
+    QCOMPARE(result.failed, 1);
+    QVERIFY(!QFile::exists(expectedJobs[1].outputFile));
+    QCOMPARE(readAll(expectedJobs[2].outputFile), QByteArray("x2"));
+}
+
+void TestBatchRunner::outputCollisions()
+{
+    QVERIFY(BatchRunner::checkOutputCollisions({{"a/x.txt", "out/a/x.txt"}, {"b/x.txt", "out/b/x.txt"}}));
+    QVERIFY(!BatchRunner::checkOutputCollisions({{"a/x.txt", "out/x.txt"}, {"b/x.txt", "out/x.txt"}}));
+    QVERIFY(!BatchRunner::checkOutputCollisions({{"a/x.txt", "out/x.txt"}, {"b/x.txt", "out/./sub/../x.txt"}}));
+}
+
+QTEST_MAIN(TestBatchRunner)
+#include "tst_batchrunner.moc"
@@ -0,0 +1,92 @@
+#include "piecetablebackend.h"
+#include "texteditbackend.h"
+
+#include <QPlainTextEdit>
+#include <QTest>
+
+/**
+ * @brief Moves of the headless backend compared to the same moves of a QTextCursor
+ */
+class TestDocumentBackend : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void movePosition_data();
+    void movePosition();
+    void rawText();
+};
+
+void TestDocumentBackend::movePosition_data()
+{
+    QTest::addColumn<qsizetype>("anchor");
+    QTest::addColumn<qsizetype>("position");
+    QTest::addColumn<int>("operation");
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("count");
+
+    const int move = QTextCursor::MoveAnchor;
+    const int keep = QTextCursor::KeepAnchor;
+    QTest::newRow("previous, selection forward") << qsizetype(2) << qsizetype(5) << int(QTextCursor::PreviousCharacter)
+                                                 << move << 1;
+    QTest::newRow("previous, selection backward")
+        << qsizetype(5) << qsizetype(2) << int(QTextCursor::PreviousCharacter) << move << 1;
+    QTest::newRow("next, selection forward") << qsizetype(2) << qsizetype(5) << int(QTextCursor::NextCharacter)
+                                             << move << 1;
+    QTest::newRow("next, selection backward") << qsizetype(5) << qsizetype(2) << int(QTextCursor::NextCharacter)
+                                              << move << 1;
+    QTest::newRow("left, twice") << qsizetype(2) << qsizetype(5) << int(QTextCursor::Left) << move << 2;
+    QTest::newRow("right, three times") << qsizetype(5) << qsizetype(2) << int(QTextCursor::Right) << move << 3;
+    QTest::newRow("previous, keep anchor") << qsizetype(2) << qsizetype(5) << int(QTextCursor::PreviousCharacter)
+                                           << keep << 1;
+    QTest::newRow("next, keep anchor") << qsizetype(5) << qsizetype(2) << int(QTextCursor::NextCharacter) << keep
+                                       << 2;
+    QTest::newRow("next, no selection") << qsizetype(3) << qsizetype(3) << int(QTextCursor::NextCharacter) << move
+                                        << 2;
+    QTest::newRow("next word, selection") << qsizetype(1) << qsizetype(2) << int(QTextCursor::NextWord) << move
+                                          << 1;
+}
+
+void TestDocumentBackend::movePosition()
+{
+    QFETCH(qsizetype, anchor);
+    QFETCH(qsizetype, position);
+    QFETCH(int, operation);
+    QFETCH(int, mode);
+    QFETCH(int, count);
+
+    QPlainTextEdit textEdit;
+    TextEditBackend textEditBackend(&textEdit);
+    PieceTableBackend pieceTableBackend;
+    for (DocumentBackend *backend : std::initializer_list<DocumentBackend *> {&textEditBackend, &pieceTableBackend}) {
+        backend->setText("abc def\nghi");
+        backend->setPosition(anchor);
+        backend->setPosition(position, QTextCursor::KeepAnchor);
+        backend->movePosition(QTextCursor::MoveOperation(operation), QTextCursor::MoveMode(mode), count);
+    }
+    QCOMPARE(pieceTableBackend.position(), textEditBackend.position());
+    QCOMPARE(pieceTableBackend.anchor(), textEditBackend.anchor());
+}
+
+// The range of a QTextDocument is its stored text, the whole text and the chunks are normalized
+void TestDocumentBackend::rawText()
+{
+    QPlainTextEdit textEdit;
+    TextEditBackend backend(&textEdit);
+    const QString text = QString("a") + QChar::Nbsp + "b" + QChar::LineSeparator + "c\nd";
+    backend.setText(text);
+
+    QCOMPARE(backend.text(), QString("a b\nc\nd"));
+    QCOMPARE(backend.text(0, text.size()), text);
+    QCOMPARE(backend.text(1, 6), text.mid(1, 5));
+    QCOMPARE(backend.text(6, 7), QString("d"));
+    QString chunks;
+    backend.forEachChunk(2, [&chunks](qsizetype, QStringView chunk) {
+        chunks.append(chunk);
+        return true;
+    });
+    QCOMPARE(chunks, QString("b\nc\nd"));
+}
+
+QTEST_MAIN(TestDocumentBackend)
+#include "tst_documentbackend.moc"
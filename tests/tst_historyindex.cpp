@@ -0,0 +1,171 @@
+#include "historyfiltermodel.h"
+#include "historyindex.h"
+#include "historymodel.h"
+#include "logger.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+using Rows = std::vector<qint64>;
+
+class TestHistoryIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    const ApiId m_insert = ApiRegistry::registerApi("TextDocument::insert");
+    const ApiId m_find = ApiRegistry::registerApi("TextDocument::find");
+
+private slots:
+    void initTestCase();
+
+    void candidates();
+    void removeBefore();
+    void findRows();
+    void mergedRows();
+    void filterModel();
+};
+
+void TestHistoryIndex::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestHistoryIndex::candidates()
+{
+    HistoryIndex index;
+    index.addRow(0, m_insert, {"Hello world"});
+    index.addRow(1, m_find, {"help"});
+    index.addRow(2, m_insert, {"WORLD", "wide"});
+    QCOMPARE(index.nextRow(), qint64(3));
+
+    // Too short to use the trigrams, all rows are candidates
+    QVERIFY(!index.candidates({}, "wo").has_value());
+
+    QCOMPARE(*index.candidates({}, "world"), (Rows {0, 2}));
+    QCOMPARE(*index.candidates({}, "hel"), (Rows {0, 1}));
+    QCOMPARE(*index.candidates({}, "xyz"), Rows {});
+    QCOMPARE(*index.candidates({m_find}, "hel"), Rows {1});
+    QCOMPARE(*index.candidates({m_find}, "wo"), Rows {1});
+    QCOMPARE(*index.candidates({m_insert, m_find}, ""), (Rows {0, 1, 2}));
+
+    QCOMPARE(*index.candidates({}, "wide world"), Rows {});
+
+    // A merged row is indexed again
+    index.addRow(2, m_insert, {"WORLD wide web"});
+    QCOMPARE(index.nextRow(), qint64(3));
+    QCOMPARE(*index.candidates({}, "web"), Rows {2});
+    QCOMPARE(*index.candidates({}, "wor"), (Rows {0, 2}));
+
+    // Trigrams are not checked for adjacency: a candidate may not contain the text
+    index.addRow(3, m_find, {"abc", "bcd"});
+    QCOMPARE(*index.candidates({}, "abcd"), Rows {3});
+}
+
+void TestHistoryIndex::removeBefore()
+{
+    HistoryIndex index;
+    for (qint64 row = 0; row < 10; ++row)
+        index.addRow(row, row % 2 ? m_find : m_insert, {QString("text %1").arg(row)});
+
+    index.removeBefore(4);
+    QCOMPARE(*index.candidates({}, "text"), (Rows {4, 5, 6, 7, 8, 9}));
+    QCOMPARE(*index.candidates({m_find}, ""), (Rows {5, 7, 9}));
+
+    // Pruned lists give the same result
+    index.removeBefore(7);
+    QCOMPARE(*index.candidates({}, "text"), (Rows {7, 8, 9}));
+    QCOMPARE(*index.candidates({}, "t 8"), Rows {8});
+
+    index.removeBefore(12);
+    QCOMPARE(index.nextRow(), qint64(12));
+    QCOMPARE(*index.candidates({}, "text"), Rows {});
+    index.addRow(12, m_insert, {"text 12"});
+    QCOMPARE(*index.candidates({}, "text"), Rows {12});
+}
+
+void TestHistoryIndex::findRows()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    TextDocument document;
+    document.setText("Lorem ipsum dolor sit amet");
+
+    const QStringList words = {"lorem", "Ipsum", "dolor", "sit", "amet", "ipsum"};
+    for (const auto &word : words) {
+        document.insert(word);
+        document.find(word);
+    }
+    QTRY_COMPARE(model.rowCount(), static_cast<int>(2 * words.size()));
+    model.setMaxRows(10);
+
+    const std::vector<HistoryModel::Filter> filters = {
+        {"", "ipsum", Qt::CaseInsensitive}, {"", "ipsum", Qt::CaseSensitive}, {"find", "or", Qt::CaseInsensitive},
+        {"insert", "", Qt::CaseInsensitive}, {"TextDocument::find", "ame", Qt::CaseInsensitive},
+        {"", "psu", Qt::CaseInsensitive},    {"unknown", "", Qt::CaseInsensitive},
+    };
+    for (const auto &filter : filters) {
+        std::vector<int> expected;
+        for (int row = 0; row < model.rowCount(); ++row) {
+            if (model.matches(row, filter))
+                expected.push_back(row);
+        }
+        QCOMPARE(model.findRows(filter), expected);
+    }
+    QCOMPARE(model.findRows({"", "ipsum", Qt::CaseInsensitive}).size(), size_t(3));
+}
+
+// The last row is indexed again after a search, when it's merged
+void TestHistoryIndex::mergedRows()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    TextDocument document;
+
+    const QStringList parts = {"ab", "cd", "ef", "gh"};
+    QString typed;
+    for (const auto &part : parts) {
+        document.insert(part);
+        typed += part;
+        QTRY_COMPARE(model.rowCount(), 1);
+        QCOMPARE(model.findRows({"", typed, Qt::CaseInsensitive}), std::vector<int> {0});
+    }
+    document.find("gh");
+    QTRY_COMPARE(model.rowCount(), 2);
+    document.insert("ij");
+    QTRY_COMPARE(model.rowCount(), 3);
+    QCOMPARE(model.findRows({"", "cdef", Qt::CaseInsensitive}), std::vector<int> {0});
+    QCOMPARE(model.findRows({"", "gh", Qt::CaseInsensitive}), (std::vector<int> {0, 1}));
+    QCOMPARE(model.findRows({"insert", "ij", Qt::CaseInsensitive}), std::vector<int> {2});
+}
+
+void TestHistoryIndex::filterModel()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    HistoryFilterModel filterModel(&model);
+    filterModel.setFilter({"insert", "ab", Qt::CaseInsensitive});
+    TextDocument document;
+
+    document.insert("abc");
+    document.gotoStartOfDocument();
+    document.insert("xyz");
+    document.gotoEndOfDocument();
+    document.insert("AB");
+    QTRY_COMPARE(model.rowCount(), 5);
+    QCOMPARE(filterModel.rowCount(), 2);
+    QCOMPARE(filterModel.mapToSource(filterModel.index(1, 0)).row(), 4);
+
+    // A merge may make the last row match
+    document.gotoStartOfDocument();
+    document.insert("x");
+    document.insert("ab");
+    QTRY_COMPARE(model.rowCount(), 7);
+    QCOMPARE(filterModel.rowCount(), 3);
+
+    filterModel.setFilter({});
+    QCOMPARE(filterModel.rowCount(), 7);
+}
+
+QTEST_MAIN(TestHistoryIndex)
+#include "tst_historyindex.moc"
@@ -0,0 +1,97 @@
+#include "historyjournal.h"
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestHistoryJournal : public QObject
+{
+    Q_OBJECT
+
+private:
+    static HistoryStore::Record row(ApiId apiId, const QString &text)
+    {
+        return {apiId, {{"text", text}}, {}};
+    }
+
+private slots:
+    void manyApis();
+    void coalescedMerges();
+};
+
+void TestHistoryJournal::manyApis()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.filePath("journal");
+    const int apiCount = 2 * Journal::InitialApiCapacity;
+
+    std::vector<ApiId> apis;
+    for (int i = 0; i < apiCount; ++i)
+        apis.push_back(ApiRegistry::registerApi(QString("TestHistoryJournal::api%1").arg(i)));
+
+    JournalWriter writer;
+    QVERIFY(writer.open(fileName));
+    for (int i = 0; i < apiCount; ++i) {
+        writer.appendRow(row(apis[i], QString::number(i)));
+        // Grow the API table with rows already in the index
+        if (i % 100 == 0)
+            writer.flush();
+    }
+    writer.close();
+
+    JournalReader reader;
+    QVERIFY(reader.open(fileName));
+    QVERIFY(reader.isIndexComplete());
+    QVERIFY(reader.apiCapacity() >= static_cast<quint32>(apiCount));
+    QCOMPARE(reader.size(), apiCount);
+    for (int i = 0; i < apiCount; ++i) {
+        QCOMPARE(reader.apiId(i), apis[i]);
+        QCOMPARE(reader.argValue(i, 0).toString(), QString::number(i));
+    }
+    reader.close();
+
+    // Continue the journal
+    QVERIFY(writer.open(fileName));
+    writer.appendRow(row(apis.front(), "last"));
+    writer.close();
+    QVERIFY(reader.open(fileName));
+    QVERIFY(reader.isIndexComplete());
+    QCOMPARE(reader.size(), apiCount + 1);
+    QCOMPARE(reader.argValue(apiCount, 0).toString(), QString("last"));
+}
+
+void TestHistoryJournal::coalescedMerges()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.filePath("journal");
+    const ApiId apiId = ApiRegistry::registerApi("TestHistoryJournal::insert");
+
+    JournalWriter writer;
+    QVERIFY(writer.open(fileName));
+    writer.appendRow(row(apiId, "first"));
+    writer.appendRow(row(apiId, "a"));
+    QString text = "a";
+    for (int i = 0; i < 1000; ++i) {
+        text += 'a';
+        writer.replaceLastRow(row(apiId, text));
+    }
+    writer.flush();
+    // Only the last state of the merged row is written
+    const qint64 sizeAfterMerges = QFileInfo(fileName).size();
+    QVERIFY(sizeAfterMerges < 2 * text.size() * 2 + 512);
+
+    // A merge into a row already written replaces it
+    text += 'b';
+    writer.replaceLastRow(row(apiId, text));
+    writer.close();
+
+    JournalReader reader;
+    QVERIFY(reader.open(fileName));
+    QVERIFY(reader.isIndexComplete());
+    QCOMPARE(reader.size(), 2);
+    QCOMPARE(reader.argValue(0, 0).toString(), QString("first"));
+    QCOMPARE(reader.argValue(1, 0).toString(), text);
+}
+
+QTEST_MAIN(TestHistoryJournal)
+#include "tst_historyjournal.moc"
@@ -0,0 +1,124 @@
+#include "historymodel.h"
+#include "logger.h"
+#include "textdocument.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestHistoryModel : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString params(const HistoryModel &model, int row)
+    {
+        return model.data(model.index(row, HistoryModel::ParamCol)).toString();
+    }
+
+private slots:
+    void initTestCase();
+
+    void data();
+    void evictionAcrossRestart();
+};
+
+void TestHistoryModel::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestHistoryModel::data()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    TextDocument document;
+
+    document.insert("ab");
+    QTRY_COMPARE(model.rowCount(), 1);
+    QCOMPARE(model.data(model.index(0, HistoryModel::NameCol)).toString(), QString("TextDocument::insert"));
+    QCOMPARE(params(model, 0), QString("\"ab\""));
+
+    // A merge updates the cached row
+    document.insert("cd");
+    QTRY_COMPARE(params(model, 0), QString("\"abcd\""));
+    QCOMPARE(model.rowCount(), 1);
+
+    document.gotoPreviousChar(2);
+    document.insert("e");
+    QTRY_COMPARE(model.rowCount(), 3);
+    QCOMPARE(params(model, 1), QString("2"));
+    QCOMPARE(params(model, 2), QString("\"e\""));
+
+    // Cached rows follow the rows when the first ones are removed
+    model.setMaxRows(2);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(params(model, 0), QString("2"));
+    QCOMPARE(params(model, 1), QString("\"e\""));
+
+    model.clear();
+    document.insert("f");
+    QTRY_COMPARE(model.rowCount(), 1);
+    QCOMPARE(params(model, 0), QString("\"f\""));
+}
+
+void TestHistoryModel::evictionAcrossRestart()
+{
+    QTemporaryDir dir;
+    const QString journal = dir.filePath("journal");
+    const QString archive = dir.filePath("archive");
+    TextDocument document;
+    document.setText("abcdefgh");
+
+    auto openModel = [&](HistoryModel &model) {
+        model.setBatchInterval(-1);
+        QVERIFY(model.openJournal(journal));
+        QVERIFY(model.openArchive(archive));
+        model.setMaxRows(3);
+    };
+
+    {
+        HistoryModel model;
+        openModel(model);
+        document.insert("r0");
+        document.gotoNextChar(1);
+        document.insert("r2");
+        document.gotoNextChar(3);
+        document.insert("r4");
+        QTRY_COMPARE(model.evictedRows(), qint64(2));
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(model.archivedRows(), 2);
+    }
+
+    // The rows evicted before the restart are neither restored nor archived again
+    {
+        HistoryModel model;
+        openModel(model);
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(model.archivedRows(), 2);
+        QCOMPARE(params(model, 0), QString("\"r2\""));
+
+        // Evict a restored row
+        document.gotoNextChar(5);
+        QTRY_COMPARE(model.archivedRows(), 3);
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(params(model, 0), QString("3"));
+        QCOMPARE(params(model, 2), QString("5"));
+
+        const QString script = model.createScript(-3, -1, HistoryModel::NoScriptOption);
+        QVERIFY2(script.contains("TextDocument.insert(\"r0\")\n"
+                                 "TextDocument.gotoNextChar(1)\n"
+                                 "TextDocument.insert(\"r2\")\n"),
+                 qPrintable(script));
+    }
+
+    {
+        HistoryModel model;
+        openModel(model);
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(model.archivedRows(), 3);
+        QCOMPARE(params(model, 0), QString("3"));
+    }
+}
+
+QTEST_MAIN(TestHistoryModel)
+#include "tst_historymodel.moc"
@@ -0,0 +1,83 @@
+#include "mappedfile.h"
+
+#include <QTemporaryFile>
+#include <QTest>
+
+#include <vector>
+
+/**
+ * @brief A mapped file compared to the same text decoded at once
+ */
+class TestMappedFile : public QObject
+{
+    Q_OBJECT
+
+private:
+    static bool write(QTemporaryFile &file, const QString &text)
+    {
+        return file.open() && file.write(text.toUtf8()) >= 0 && file.flush();
+    }
+
+private slots:
+    void emptyFile();
+    void blocks();
+};
+
+void TestMappedFile::emptyFile()
+{
+    QTemporaryFile file;
+    QVERIFY(write(file, {}));
+    MappedFile mapped;
+    QVERIFY(mapped.open(file.fileName()));
+    QVERIFY(mapped.isIndexed());
+    QCOMPARE(mapped.size(), qsizetype(0));
+    QCOMPARE(mapped.lineBreakCount(), qsizetype(0));
+    QCOMPARE(mapped.lineBreak(0), qsizetype(-1));
+}
+
+// Several blocks indexed in the background, with multi-byte characters and surrogate pairs across their boundaries
+void TestMappedFile::blocks()
+{
+    QString text;
+    for (int i = 0; text.size() < 3 * 1024 * 1024; ++i)
+        text += QString("line %1 é€").arg(i) + QString::fromUcs4(U"\U0001F600") + u'\n';
+    QTemporaryFile file;
+    QVERIFY(write(file, text));
+
+    MappedFile mapped;
+    QVERIFY(mapped.open(file.fileName()));
+    // Usable before the end of the indexing
+    QCOMPARE(mapped.text(0, 20), text.first(20));
+    QCOMPARE(mapped.at(text.size() - 1), u'\n');
+
+    QCOMPARE(mapped.size(), text.size());
+    QVERIFY(mapped.isIndexed());
+    std::vector<qsizetype> lineBreaks;
+    for (qsizetype position = text.indexOf(u'\n'); position != -1; position = text.indexOf(u'\n', position + 1))
+        lineBreaks.push_back(position);
+    const auto lineBreakCount = static_cast<qsizetype>(lineBreaks.size());
+    QCOMPARE(mapped.lineBreakCount(), lineBreakCount);
+    for (const qsizetype index : {qsizetype(0), lineBreakCount / 3, lineBreakCount / 2, lineBreakCount - 1})
+        QCOMPARE(mapped.lineBreak(index), lineBreaks[index]);
+    QCOMPARE(mapped.lineBreak(lineBreakCount), qsizetype(-1));
+
+    for (const qsizetype position : {qsizetype(1000), text.size() / 3, text.size() / 2, text.size() - 150}) {
+        QCOMPARE(mapped.at(position), text.at(position));
+        QCOMPARE(mapped.text(position - 100, position + 100), text.sliced(position - 100, 200));
+        QCOMPARE(mapped.lineBreaksBefore(position), text.first(position).count(u'\n'));
+    }
+
+    QString blocks;
+    int blockCount = 0;
+    mapped.forEachBlock(10, [&blocks, &blockCount](qsizetype position, QStringView block) {
+        if (blockCount++ == 0 && position != 10)
+            return false;
+        blocks += block;
+        return true;
+    });
+    QVERIFY(blockCount > 2);
+    QCOMPARE(blocks, text.sliced(10));
+}
+
+QTEST_MAIN(TestMappedFile)
+#include "tst_mappedfile.moc"
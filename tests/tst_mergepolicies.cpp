@@ -0,0 +1,136 @@
+#include "historymodel.h"
+#include "historystore.h"
+#include "logger.h"
+#include "mergepolicies.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+class TestMergePolicies : public QObject
+{
+    Q_OBJECT
+
+private:
+    const ApiId m_apiId = ApiRegistry::registerApi("TestMergePolicies::call");
+
+private slots:
+    void initTestCase();
+
+    void merge_data();
+    void merge();
+    void custom();
+    void storeMerge();
+    void rowBudget();
+};
+
+void TestMergePolicies::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestMergePolicies::merge_data()
+{
+    QTest::addColumn<int>("apiPolicy");
+    QTest::addColumn<QVariant>("value");
+    QTest::addColumn<QVariant>("next");
+    QTest::addColumn<bool>("merged");
+    QTest::addColumn<QVariant>("result");
+
+    const int typePolicy = -1;
+    QTest::newRow("int") << typePolicy << QVariant(2) << QVariant(3) << true << QVariant(5);
+    QTest::newRow("double") << typePolicy << QVariant(0.5) << QVariant(1.) << true << QVariant(1.5);
+    QTest::newRow("string") << typePolicy << QVariant("ab") << QVariant("cd") << true << QVariant("abcd");
+    QTest::newRow("string list") << typePolicy << QVariant(QStringList {"a"}) << QVariant(QStringList {"b"}) << true
+                                 << QVariant(QStringList {"a", "b"});
+    QTest::newRow("bool") << typePolicy << QVariant(true) << QVariant(false) << false << QVariant(true);
+    QTest::newRow("different types") << typePolicy << QVariant(1) << QVariant(1.) << false << QVariant(1);
+
+    QTest::newRow("no merge") << int(MergePolicies::NoMerge) << QVariant(2) << QVariant(3) << false << QVariant(2);
+    QTest::newRow("last wins") << int(MergePolicies::LastWins) << QVariant("ab") << QVariant("cd") << true
+                               << QVariant("cd");
+    QTest::newRow("max") << int(MergePolicies::Max) << QVariant(7) << QVariant(3) << true << QVariant(7);
+    QTest::newRow("max next") << int(MergePolicies::Max) << QVariant(3) << QVariant(7) << true << QVariant(7);
+    QTest::newRow("sum string") << int(MergePolicies::Sum) << QVariant("ab") << QVariant("cd") << false
+                                << QVariant("ab");
+}
+
+void TestMergePolicies::merge()
+{
+    QFETCH(int, apiPolicy);
+    QFETCH(QVariant, value);
+    QFETCH(QVariant, next);
+    QFETCH(bool, merged);
+    QFETCH(QVariant, result);
+
+    MergePolicies policies;
+    if (apiPolicy != -1)
+        policies.setApiPolicy(m_apiId, static_cast<MergePolicies::Policy>(apiPolicy));
+
+    QCOMPARE(policies.merge(m_apiId, value, next), merged);
+    if (merged)
+        QCOMPARE(value, result);
+}
+
+void TestMergePolicies::custom()
+{
+    MergePolicies policies;
+    policies.setApiPolicy(m_apiId, [](QVariant &value, const QVariant &next) {
+        value = value.toString() + ',' + next.toString();
+        return true;
+    });
+    QVariant value("a");
+    QVERIFY(policies.merge(m_apiId, value, QVariant("b")));
+    QCOMPARE(value, QVariant("a,b"));
+
+    // The merged value must keep its type
+    value = 1;
+    QVERIFY(!policies.merge(m_apiId, value, QVariant(2)));
+
+    // The type policy is used again once the API policy is reset
+    policies.resetApiPolicy(m_apiId);
+    value = 1;
+    QVERIFY(policies.merge(m_apiId, value, QVariant(2)));
+    QCOMPARE(value, QVariant(3));
+}
+
+void TestMergePolicies::storeMerge()
+{
+    MergePolicies policies;
+    HistoryStore store;
+    store.append({m_apiId, {{"", QString("a")}, {"", 1}}, {}});
+
+    QString text = "a";
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(store.mergeIntoLast({m_apiId, {{"", QString("b")}, {"", 1}}, {}}, policies));
+        text += u'b';
+    }
+    QCOMPARE(store.size(), 1);
+    QCOMPARE(store.argValue(0, 0), QVariant(text));
+    QCOMPARE(store.argValue(0, 1), QVariant(1001));
+
+    // The row is unchanged if an argument can't be merged
+    QVERIFY(!store.mergeIntoLast({m_apiId, {{"", QString("c")}, {"", true}}, {}}, policies));
+    QCOMPARE(store.argValue(0, 0), QVariant(text));
+    QCOMPARE(store.argValue(0, 1), QVariant(1001));
+    QVERIFY(!store.mergeIntoLast({m_apiId, {{"", QString("c")}}, {}}, policies));
+    QCOMPARE(store.argValue(0, 0), QVariant(text));
+}
+
+void TestMergePolicies::rowBudget()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    model.mergePolicies().setApiLimits(ApiRegistry::registerApi("TextDocument::gotoNextChar"), {0, 3});
+    TextDocument document;
+    document.setText(QString(10, u'a'));
+
+    for (int i = 0; i < 7; ++i)
+        document.gotoNextChar();
+    QTRY_COMPARE(model.rowCount(), 3);
+    QCOMPARE(model.data(model.index(0, HistoryModel::ParamCol)).toString(), QString("3"));
+    QCOMPARE(model.data(model.index(1, HistoryModel::ParamCol)).toString(), QString("3"));
+    QCOMPARE(model.data(model.index(2, HistoryModel::ParamCol)).toString(), QString("1"));
+}
+
+QTEST_MAIN(TestMergePolicies)
+#include "tst_mergepolicies.moc"
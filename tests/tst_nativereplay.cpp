@@ -0,0 +1,109 @@
+#include "logger.h"
+#include "nativereplay.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+class TestNativeReplay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void fromScript_data();
+    void fromScript();
+    void fallback_data();
+    void fallback();
+    void slices();
+};
+
+void TestNativeReplay::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestNativeReplay::fromScript_data()
+{
+    QTest::addColumn<QString>("script");
+    QTest::addColumn<int>("size");
+    // Text after the replay on "hello world"
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("empty") << QString("\n// Only a comment\n") << 0 << QString("hello world");
+    QTest::newRow("calls") << QString("TextDocument.gotoEndOfDocument();\nTextDocument.insert(\"!\");\n") << 2
+                           << QString("hello world!");
+    QTest::newRow("default count") << QString("TextDocument.gotoNextChar()\nTextDocument.deleteNextCharacter(2)") << 2
+                                   << QString("hlo world");
+    QTest::newRow("escapes") << QString("TextDocument.insert(\"a\\n\\t\\\"\\\\'\");") << 1
+                             << QString("a\n\t\"\\'hello world");
+    QTest::newRow("variable") << QString("TextDocument.selectEndOfWord();\nlet word = TextDocument.selectedText;\n"
+                                         "TextDocument.gotoEndOfDocument();\nTextDocument.insert(word);")
+                              << 4 << QString("hello worldhello");
+    QTest::newRow("variable assigned again")
+        << QString("var w = TextDocument.currentWord;\nTextDocument.gotoNextWord();\n"
+                   "w = TextDocument.currentWord;\nTextDocument.insert(w);")
+        << 4 << QString("hello worldworld");
+}
+
+void TestNativeReplay::fromScript()
+{
+    QFETCH(QString, script);
+    QFETCH(int, size);
+    QFETCH(QString, text);
+
+    const auto replay = NativeReplay::fromScript(script);
+    QVERIFY(replay);
+    QCOMPARE(replay->size(), size);
+
+    TextDocument document;
+    document.setText("hello world");
+    document.gotoStartOfDocument();
+    replay->run(&document);
+    QCOMPARE(document.text(), text);
+}
+
+void TestNativeReplay::fallback_data()
+{
+    QTest::addColumn<QString>("script");
+
+    QTest::newRow("loop") << QString("for (let i = 0; i < 2; ++i)\n    TextDocument.insert(\"a\");");
+    QTest::newRow("other api") << QString("console.log(\"a\");");
+    QTest::newRow("unknown method") << QString("TextDocument.undo();");
+    QTest::newRow("expression argument") << QString("TextDocument.insert(\"a\" + \"b\");");
+    QTest::newRow("unknown escape") << QString("TextDocument.insert(\"\\u0041\");");
+    QTest::newRow("unterminated string") << QString("TextDocument.insert(\"a);");
+    QTest::newRow("unknown variable") << QString("TextDocument.insert(word);");
+    QTest::newRow("call assigned") << QString("let found = TextDocument.find(\"a\");");
+    QTest::newRow("two calls on a line") << QString("TextDocument.unselect(); TextDocument.selectAll();");
+    QTest::newRow("missing parenthesis") << QString("TextDocument.gotoNextChar;");
+}
+
+// Anything else than straight-line calls needs the javascript engine
+void TestNativeReplay::fallback()
+{
+    QFETCH(QString, script);
+    QVERIFY(!NativeReplay::fromScript(script));
+}
+
+// A replay run in several slices gives the same result
+void TestNativeReplay::slices()
+{
+    QString script;
+    for (int i = 0; i < 10; ++i)
+        script += QString("TextDocument.insert(\"%1\");\n").arg(i);
+    const auto replay = NativeReplay::fromScript(script);
+    QVERIFY(replay);
+
+    TextDocument document;
+    NativeReplay::State state;
+    QVERIFY(!replay->run(&document, state, 4));
+    QCOMPARE(document.text(), QString("0123"));
+    QVERIFY(!replay->run(&document, state, 4));
+    QVERIFY(replay->run(&document, state, 4));
+    QCOMPARE(document.text(), QString("0123456789"));
+    QCOMPARE(state.next, 10);
+}
+
+QTEST_MAIN(TestNativeReplay)
+#include "tst_nativereplay.moc"
@@ -0,0 +1,90 @@
+#include "piecetable.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+
+/**
+ * @brief Edits of a piece table compared to the same edits on a QString
+ */
+class TestPieceTable : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void compare(const PieceTable &table, const QString &expected)
+    {
+        QCOMPARE(table.size(), expected.size());
+        QCOMPARE(table.text(), expected);
+        QCOMPARE(table.lineCount(), expected.count(u'\n') + 1);
+        for (qsizetype line = 0, start = 0; line < table.lineCount(); ++line) {
+            QCOMPARE(table.lineStart(line), start);
+            const qsizetype end = expected.indexOf(u'\n', start);
+            QCOMPARE(table.lineEnd(line), end == -1 ? expected.size() : end);
+            QCOMPARE(table.lineAt(start), line);
+            start = end + 1;
+        }
+    }
+
+private slots:
+    void insertIntoEmpty();
+    void randomEdits_data();
+    void randomEdits();
+};
+
+void TestPieceTable::insertIntoEmpty()
+{
+    PieceTable table;
+    table.insert(0, u"abc");
+    compare(table, "abc");
+    table.insert(3, u"\nd");
+    compare(table, "abc\nd");
+
+    PieceTable emptyText(QString {});
+    emptyText.insert(0, u"x");
+    compare(emptyText, "x");
+
+    // Removing everything leaves an empty table, used again
+    table.remove(0, table.size());
+    compare(table, "");
+    table.insert(0, u"e");
+    table.insert(1, u"f");
+    compare(table, "ef");
+}
+
+void TestPieceTable::randomEdits_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("lines") << QString("hello\nworld\n");
+}
+
+void TestPieceTable::randomEdits()
+{
+    QFETCH(QString, text);
+
+    PieceTable table(text);
+    QString expected = text;
+    QRandomGenerator generator(7);
+    for (int i = 0; i < 500; ++i) {
+        const qsizetype position = generator.bounded(static_cast<int>(expected.size()) + 1);
+        if (generator.bounded(3) > 0) {
+            // Appends at the end are frequent, as when typing
+            const qsizetype at = generator.bounded(2) ? expected.size() : position;
+            const QString inserted = generator.bounded(4) ? QString("ab") : QString("\nc");
+            table.insert(at, inserted);
+            expected.insert(at, inserted);
+        } else {
+            const qsizetype length = generator.bounded(static_cast<int>(expected.size() - position) + 1);
+            table.remove(position, length);
+            expected.remove(position, length);
+        }
+        compare(table, expected);
+        if (QTest::currentTestFailed())
+            QFAIL(qPrintable(QString("edit %1").arg(i)));
+    }
+    QCOMPARE(table.indexOf(u"b\nc", 0), expected.indexOf("b\nc"));
+}
+
+QTEST_MAIN(TestPieceTable)
+#include "tst_piecetable.moc"
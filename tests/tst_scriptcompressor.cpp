@@ -0,0 +1,135 @@
+#include "historymodel.h"
+#include "logger.h"
+#include "scriptcompressor.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+using Record = HistoryStore::Record;
+using Records = std::vector<Record>;
+Q_DECLARE_METATYPE(Records)
+
+class TestScriptCompressor : public QObject
+{
+    Q_OBJECT
+
+private:
+    static Record call(const char *name, QVariant value = {})
+    {
+        Record record;
+        record.apiId = ApiRegistry::registerApi(QString("TextDocument::%1").arg(name));
+        if (value.isValid())
+            record.params.push_back({QString(), std::move(value)});
+        return record;
+    }
+
+    static QString callText(const Record &record, const std::vector<int> &steps = {})
+    {
+        QStringList params;
+        for (size_t i = 0; i < record.params.size(); ++i) {
+            QString text = record.params[i].value.toString();
+            if (i < steps.size() && steps[i] != 0)
+                text += QString("%1%2i").arg(steps[i] > 0 ? "+" : "").arg(steps[i]);
+            params.push_back(text);
+        }
+        return QString("%1(%2)").arg(ApiRegistry::info(record.apiId).name.split("::").last(), params.join(", "));
+    }
+
+    // Calls separated by spaces, a loop is written count x [body]
+    static QString compress(const Records &records)
+    {
+        QStringList output;
+        ScriptCompressor compressor([&](const Record &record) { output.push_back(callText(record)); },
+                                    [&](const ScriptCompressor::Loop &loop) {
+                                        QStringList body;
+                                        for (size_t i = 0; i < loop.body.size(); ++i)
+                                            body.push_back(callText(loop.body[i], loop.steps[i]));
+                                        output.push_back(QString("%1x[%2]").arg(loop.count).arg(body.join(' ')));
+                                    });
+        for (auto record : records)
+            compressor.push(std::move(record));
+        compressor.finish();
+        return output.join(' ');
+    }
+
+private slots:
+    void initTestCase();
+
+    void compress_data();
+    void compress();
+    void script();
+};
+
+void TestScriptCompressor::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestScriptCompressor::compress_data()
+{
+    QTest::addColumn<Records>("calls");
+    QTest::addColumn<QString>("result");
+
+    QTest::newRow("sequence") << Records {call("remove", 1), call("remove", 2), call("remove", 3), call("remove", 4)}
+                              << QString("4x[remove(1+1i)]");
+    QTest::newRow("decreasing sequence")
+        << Records {call("gotoNextLine", 9), call("gotoNextLine", 7), call("gotoNextLine", 5), call("gotoNextLine", 3)}
+        << QString("4x[gotoNextLine(9-2i)]");
+    QTest::newRow("block") << Records {call("insert", QString("a")), call("gotoNextLine", 1),
+                                       call("insert", QString("a")), call("gotoNextLine", 1),
+                                       call("insert", QString("a")), call("gotoNextLine", 1)}
+                           << QString("3x[insert(a) gotoNextLine(1)]");
+    QTest::newRow("prefix and suffix")
+        << Records {call("gotoEndOfDocument"), call("deleteNextCharacter", 1), call("deleteNextCharacter", 1),
+                    call("deleteNextCharacter", 1), call("deleteNextCharacter", 1), call("selectAll")}
+        << QString("gotoEndOfDocument() 4x[deleteNextCharacter(1)] selectAll()");
+
+    // A loop needs to save lines, and 2 values are not a sequence
+    QTest::newRow("too short") << Records {call("insert", QString("a")), call("insert", QString("a")),
+                                           call("insert", QString("a"))}
+                               << QString("insert(a) insert(a) insert(a)");
+    QTest::newRow("2 values") << Records {call("gotoNextLine", 1), call("gotoNextLine", 2)}
+                              << QString("gotoNextLine(1) gotoNextLine(2)");
+
+    // Only plain calls are rolled
+    Record named = call("insert", QString("a"));
+    named.params.front().name = "text";
+    QTest::newRow("named argument") << Records {named, named, named, named}
+                                    << QString("insert(a) insert(a) insert(a) insert(a)");
+}
+
+void TestScriptCompressor::compress()
+{
+    QFETCH(Records, calls);
+    QFETCH(QString, result);
+
+    QCOMPARE(TestScriptCompressor::compress(calls), result);
+}
+
+void TestScriptCompressor::script()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    TextDocument document;
+    document.setText("a\nb\nc\nd\n");
+
+    for (int i = 0; i < 4; ++i) {
+        document.insert("- ");
+        document.gotoNextLine();
+    }
+    QTRY_COMPARE(model.rowCount(), 8);
+
+    HistoryModel::ScriptStats stats;
+    const QString script = model.createScript(0, 7, HistoryModel::RollLoops, &stats);
+    QVERIFY2(script.contains("for (let i = 0; i < 4; ++i) {\n"
+                             "    TextDocument.insert(\"- \")\n"
+                             "    TextDocument.gotoNextLine(1)\n"
+                             "}\n"),
+             qPrintable(script));
+    QCOMPARE(stats.recordedCalls, 8);
+    QCOMPARE(stats.generatedCalls, 2);
+    QCOMPARE(stats.loops, 1);
+}
+
+QTEST_MAIN(TestScriptCompressor)
+#include "tst_scriptcompressor.moc"
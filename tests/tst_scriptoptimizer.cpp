@@ -0,0 +1,129 @@
+#include "nativereplay.h"
+#include "scriptoptimizer.h"
+#include "textdocument.h"
+
+#include <QPlainTextEdit>
+#include <QTest>
+
+using Record = HistoryStore::Record;
+using Records = std::vector<Record>;
+Q_DECLARE_METATYPE(Records)
+
+class TestScriptOptimizer : public QObject
+{
+    Q_OBJECT
+
+private:
+    static Record call(const char *name, QVariant value = {})
+    {
+        Record record;
+        record.apiId = ApiRegistry::registerApi(QString("TextDocument::%1").arg(name));
+        if (value.isValid())
+            record.params.push_back({QString(), std::move(value)});
+        return record;
+    }
+
+    static Records optimize(const Records &records)
+    {
+        Records result;
+        ScriptOptimizer optimizer([&result](Record &&record) {
+            result.push_back(std::move(record));
+        });
+        for (auto record : records)
+            optimizer.push(std::move(record));
+        optimizer.finish();
+        return result;
+    }
+
+    // Replay the calls, with a marker inserted at the final position
+    static QString replay(TextDocument &document, const QString &text, const Records &records)
+    {
+        NativeReplay replay;
+        for (const auto &record : records) {
+            if (!replay.addRecord(record))
+                return {};
+        }
+        replay.addRecord(call("insert", QString("|")));
+
+        document.setText(text);
+        replay.run(&document);
+        return document.text();
+    }
+
+private slots:
+    void optimize_data();
+    void optimize();
+};
+
+void TestScriptOptimizer::optimize_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<Records>("calls");
+    QTest::addColumn<int>("optimizedCalls");
+    QTest::addColumn<QString>("result");
+
+    QTest::newRow("same moves") << QString("abcdef")
+                                << Records {call("gotoStartOfDocument"), call("gotoNextChar", 2),
+                                            call("gotoNextChar", 3)}
+                                << 2 << QString("abcde|f");
+    QTest::newRow("moves before an absolute move")
+        << QString("abcdef")
+        << Records {call("gotoNextChar", 2), call("selectNextWord", 1), call("gotoEndOfDocument")} << 1
+        << QString("abcdef|");
+    QTest::newRow("insert then delete")
+        << QString("abc")
+        << Records {call("gotoEndOfDocument"), call("insert", QString("hello")), call("deletePreviousCharacter", 2)}
+        << 2 << QString("abchel|");
+    QTest::newRow("insert then delete more")
+        << QString("abc")
+        << Records {call("gotoEndOfDocument"), call("insert", QString("he")), call("deletePreviousCharacter", 3)}
+        << 2 << QString("ab|");
+
+    // A move clamped at a boundary isn't undone by the opposite move
+    QTest::newRow("opposite moves at the end")
+        << QString("abc")
+        << Records {call("gotoEndOfDocument"), call("gotoNextChar", 2), call("gotoPreviousChar", 2)} << 3
+        << QString("a|bc");
+    QTest::newRow("opposite moves at the start")
+        << QString("abc")
+        << Records {call("gotoStartOfDocument"), call("gotoPreviousChar", 2), call("gotoNextChar", 2)} << 3
+        << QString("ab|c");
+    QTest::newRow("opposite selections at the end")
+        << QString("abc")
+        << Records {call("gotoEndOfDocument"), call("selectNextChar", 1), call("selectPreviousChar", 1)} << 3
+        << QString("ab|");
+
+    // A character move collapses the selection to its start or end, it doesn't move from the position
+    QTest::newRow("unselect before a character move")
+        << QString("abcdef")
+        << Records {call("gotoStartOfDocument"), call("selectNextChar", 3), call("unselect"),
+                    call("gotoPreviousChar", 1)}
+        << 4 << QString("ab|cdef");
+    QTest::newRow("unselect before an absolute move")
+        << QString("abc")
+        << Records {call("gotoStartOfDocument"), call("selectNextChar", 2), call("unselect"), call("gotoEndOfDocument")}
+        << 1 << QString("abc|");
+}
+
+void TestScriptOptimizer::optimize()
+{
+    QFETCH(QString, text);
+    QFETCH(Records, calls);
+    QFETCH(int, optimizedCalls);
+    QFETCH(QString, result);
+
+    const Records optimized = TestScriptOptimizer::optimize(calls);
+    QCOMPARE(static_cast<int>(optimized.size()), optimizedCalls);
+
+    // Both backends give the same result, before and after the optimization
+    TextDocument headless;
+    QCOMPARE(replay(headless, text, calls), result);
+    QCOMPARE(replay(headless, text, optimized), result);
+    QPlainTextEdit textEdit;
+    TextDocument document(&textEdit);
+    QCOMPARE(replay(document, text, calls), result);
+    QCOMPARE(replay(document, text, optimized), result);
+}
+
+QTEST_MAIN(TestScriptOptimizer)
+#include "tst_scriptoptimizer.moc"
@@ -0,0 +1,191 @@
+#include "logger.h"
+#include "scriptrunner.h"
+#include "textdocument.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimer>
+
+class TestScriptRunner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void literals_data();
+    void literals();
+    void cacheDirectory();
+    void nativeSlices();
+    void timeBudget();
+    void cancelWorker();
+    void transaction_data();
+    void transaction();
+};
+
+void TestScriptRunner::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestScriptRunner::literals_data()
+{
+    QTest::addColumn<QString>("script");
+    QTest::addColumn<QString>("text");
+
+    // The loops make them javascript, not native replays
+    QTest::newRow("string") << QString("for (var i = 0; i < 2; ++i) TextDocument.insert(\"ab\");") << QString("abab");
+    QTest::newRow("same template") << QString("for (var i = 0; i < 3; ++i) TextDocument.insert('c\\u00e9\\'');")
+                                   << QString("cé'cé'cé'");
+    QTest::newRow("decimal") << QString("for (var i = 0.5; i < 2; ++i) TextDocument.insert(\"x\" + i);")
+                             << QString("x0.5x1.5");
+    QTest::newRow("identifier digits") << QString("var a1 = 'y'; for (var i = 0; i < 1; ++i) TextDocument.insert(a1);")
+                                       << QString("y");
+    QTest::newRow("object key")
+        << QString("var o = {\"k\": 'v'}; for (var i = 0; i < 1; ++i) TextDocument.insert(o.k);") << QString("v");
+    QTest::newRow("regular expression")
+        << QString("for (var i = 0; i < 1; ++i) TextDocument.insert('a/b'.replace(/\\//, '-'));") << QString("a-b");
+    QTest::newRow("template string") << QString("for (var i = 0; i < 1; ++i) TextDocument.insert(`t${i}`);")
+                                     << QString("t0");
+}
+
+// Scripts only differing by their literals share a component, the other ones are compiled as they are
+void TestScriptRunner::literals()
+{
+    QFETCH(QString, script);
+    QFETCH(QString, text);
+
+    TextDocument document;
+    ScriptRunner runner(&document);
+    runner.runScript(script);
+    QVERIFY(!runner.hasError());
+    QCOMPARE(document.text(), text);
+
+    // Run again from the component cache
+    document.setText({});
+    runner.runScript(script);
+    QCOMPARE(document.text(), text);
+}
+
+void TestScriptRunner::cacheDirectory()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    // More files than the cache keeps, MaxCacheFiles
+    for (int i = 0; i < 300; ++i) {
+        QFile file(QDir(directory.path()).filePath(QString("%1.qml").arg(i)));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+    TextDocument document;
+    ScriptRunner runner(&document);
+    runner.setCacheDirectory(directory.path());
+    QCOMPARE(QDir(directory.path()).entryList({"*.qml"}, QDir::Files).size(), 256);
+
+    // A script differing by its literals only is saved once
+    runner.runScript("for (var i = 0; i < 1; ++i) TextDocument.insert('a');");
+    runner.runScript("for (var i = 0; i < 2; ++i) TextDocument.insert('b');");
+    QVERIFY(!runner.hasError());
+    QCOMPARE(document.text(), QString("abb"));
+    QCOMPARE(QDir(directory.path()).entryList({"*.qml"}, QDir::Files).size(), 257);
+}
+
+// A native replay runs from the event loop, start() returns before it's done
+void TestScriptRunner::nativeSlices()
+{
+    QString script;
+    for (int i = 0; i < 2000; ++i)
+        script += "TextDocument.insert(\"a\");\n";
+
+    TextDocument document;
+    ScriptRunner runner(&document);
+    QSignalSpy progress(&runner, &ScriptRunner::progress);
+    QSignalSpy finished(&runner, &ScriptRunner::finished);
+    runner.start(script);
+    QVERIFY(runner.isRunning());
+    QCOMPARE(document.text(), QString());
+
+    QTRY_COMPARE(finished.count(), 1);
+    QVERIFY(!runner.hasError());
+    QCOMPARE(document.text(), QString(2000, u'a'));
+    QVERIFY(progress.count() > 0);
+    QCOMPARE(progress.last(), (QVariantList {2000, 2000}));
+}
+
+// The watchdog interrupts javascript that doesn't call the document
+void TestScriptRunner::timeBudget()
+{
+    TextDocument document;
+    ScriptRunner runner(&document);
+    runner.setTimeBudget(100);
+    runner.runScript("while (true) {}");
+    QVERIFY(runner.hasError());
+    QVERIFY(runner.errors().last().description().contains("time budget"));
+
+    // The next run isn't interrupted
+    runner.runScript("for (var i = 0; i < 1; ++i) TextDocument.insert('a');");
+    QVERIFY(!runner.hasError());
+    QCOMPARE(document.text(), QString("a"));
+}
+
+// Javascript started with a document runs in a worker, cancel() stops it and its result so far is applied
+void TestScriptRunner::cancelWorker()
+{
+    TextDocument document;
+    document.setText("b");
+    ScriptRunner runner(&document);
+    QSignalSpy finished(&runner, &ScriptRunner::finished);
+    runner.start("TextDocument.insert('a');\nwhile (true) {}");
+    QTimer::singleShot(50, &runner, &ScriptRunner::cancel);
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+    QVERIFY(runner.hasError());
+    QVERIFY(runner.errors().last().description().contains("cancelled"));
+    QCOMPARE(document.text(), QString("ab"));
+    QVERIFY(!runner.isRunning());
+}
+
+void TestScriptRunner::transaction_data()
+{
+    QTest::addColumn<QString>("script");
+    QTest::addColumn<bool>("isStarted");
+
+    const QString native =
+        "TextDocument.insert(\"ab\");\nTextDocument.gotoPreviousChar();\nTextDocument.insert(\"c\");\n";
+    const QString javascript = "for (var i = 0; i < 1; ++i) {\n" + native + "}";
+    // Transactions left open by the script are committed at the end
+    const QString open = "TextDocument.beginTransaction();\n" + native;
+    QTest::newRow("native") << native << false;
+    QTest::newRow("native, started") << native << true;
+    QTest::newRow("javascript") << javascript << false;
+    QTest::newRow("javascript, started") << javascript << true;
+    QTest::newRow("open transaction") << open << false;
+}
+
+// A script is one transaction: the signals are emitted once, at the end
+void TestScriptRunner::transaction()
+{
+    QFETCH(QString, script);
+    QFETCH(bool, isStarted);
+
+    TextDocument document;
+    ScriptRunner runner(&document);
+    QSignalSpy positionChanged(&document, &TextDocument::positionChanged);
+    QSignalSpy finished(&runner, &ScriptRunner::finished);
+    if (isStarted)
+        runner.start(script);
+    else
+        runner.runScript(script);
+    QTRY_COMPARE(finished.count(), 1);
+
+    QVERIFY(!runner.hasError());
+    QVERIFY(!document.isInTransaction());
+    QCOMPARE(document.text(), QString("acb"));
+    QCOMPARE(positionChanged.count(), 1);
+}
+
+QTEST_MAIN(TestScriptRunner)
+#include "tst_scriptrunner.moc"
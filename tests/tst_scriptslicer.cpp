@@ -0,0 +1,114 @@
+#include "historymodel.h"
+#include "logger.h"
+#include "scriptslicer.h"
+#include "textdocument.h"
+
+#include <QTest>
+
+// A call of the script, with its named arguments and return variable
+struct Call
+{
+    QString api;
+    QStringList argNames;
+    QString returnName;
+};
+using Calls = std::vector<Call>;
+Q_DECLARE_METATYPE(Calls)
+
+class TestScriptSlicer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void slice_data();
+    void slice();
+    void script();
+};
+
+void TestScriptSlicer::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestScriptSlicer::slice_data()
+{
+    QTest::addColumn<Calls>("calls");
+    // Calls kept in the slice, the last call is the target
+    QTest::addColumn<QString>("kept");
+
+    QTest::newRow("moves") << Calls {{"insert"}, {"gotoStartOfDocument"}, {"gotoNextChar"}, {"selectedText"}}
+                           << QString("1111");
+    QTest::newRow("absolute selection")
+        << Calls {{"insert"}, {"gotoNextChar"}, {"selectNextWord"}, {"selectAll"}, {"deleteSelection"}}
+        << QString("10011");
+    QTest::newRow("absolute move") << Calls {{"gotoNextLine"}, {"unselect"}, {"gotoEndOfDocument"}, {"insert"}}
+                                   << QString("0011");
+    QTest::newRow("unused read") << Calls {{"selectedText", {}, "text"}, {"gotoEndOfDocument"}, {"insert"}}
+                                 << QString("011");
+    QTest::newRow("variable") << Calls {{"currentWord", {}, "word"}, {"gotoEndOfDocument"}, {"insert", {"word"}}}
+                              << QString("111");
+    QTest::newRow("variable defined twice")
+        << Calls {{"currentWord", {}, "word"}, {"currentWord", {}, "word"}, {"gotoEndOfDocument"}, {"insert", {"word"}}}
+        << QString("0111");
+    // The find starts from the end of the selection, the anchor before the unselect
+    QTest::newRow("selection before a find")
+        << Calls {{"gotoEndOfDocument"}, {"selectPreviousWord"}, {"unselect"}, {"find"}, {"selectedText"}}
+        << QString("11111");
+    QTest::newRow("selection before a character move")
+        << Calls {{"gotoEndOfDocument"}, {"selectPreviousWord"}, {"unselect"}, {"gotoNextChar"}, {"insert"}}
+        << QString("11111");
+    QTest::newRow("unknown api") << Calls {{"insert"}, {"foo"}, {"gotoStartOfDocument"}, {"insert"}}
+                                 << QString("1111");
+}
+
+void TestScriptSlicer::slice()
+{
+    QFETCH(Calls, calls);
+    QFETCH(QString, kept);
+
+    ScriptSlicer slicer;
+    QString result(calls.size(), u'0');
+    for (auto it = calls.crbegin(); it != calls.crend(); ++it) {
+        const ApiId apiId = ApiRegistry::registerApi("TextDocument::" + it->api);
+        if (slicer.addPrevious(apiId, it->argNames, it->returnName))
+            result[std::distance(it, calls.crend()) - 1] = u'1';
+    }
+    QCOMPARE(result, kept);
+    QCOMPARE(slicer.inputCalls(), static_cast<int>(calls.size()));
+    QCOMPARE(slicer.outputCalls(), static_cast<int>(kept.count(u'1')));
+}
+
+void TestScriptSlicer::script()
+{
+    HistoryModel model;
+    model.setBatchInterval(-1);
+    TextDocument document;
+    document.setText("one two three");
+
+    document.gotoNextWord();
+    document.insert("x");
+    // The selection doesn't depend on the position
+    document.gotoNextLine();
+    document.selectAll();
+    document.deleteSelection();
+    document.insert("y");
+    QTRY_COMPARE(model.rowCount(), 6);
+
+    HistoryModel::ScriptStats stats;
+    const QString script = model.createScript(0, 5, HistoryModel::SliceScript, &stats);
+    QCOMPARE(script,
+             QString("// Description of the script\n\n"
+                     "TextDocument.gotoNextWord(1)\n"
+                     "TextDocument.insert(\"x\")\n"
+                     "TextDocument.selectAll()\n"
+                     "TextDocument.deleteSelection()\n"
+                     "TextDocument.insert(\"y\")\n"
+                     "\n// 1 calls eliminated (6 recorded, 5 generated, 0 loops)\n"));
+    QCOMPARE(stats.recordedCalls, 6);
+    QCOMPARE(stats.generatedCalls, 5);
+}
+
+QTEST_MAIN(TestScriptSlicer)
+#include "tst_scriptslicer.moc"
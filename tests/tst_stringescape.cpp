@@ -0,0 +1,122 @@
+#include "stringescape.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+
+#include <iterator>
+
+/**
+ * @brief Escaping compared to the replace() chain it replaced
+ * The test is also built as tst_stringescape_scalar with STRING_ESCAPE_NO_SIMD, so both versions give the same
+ * results as the reference.
+ */
+class TestStringEscape : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QString reference(QString text, EscapeMode mode)
+    {
+        if (mode == EscapeMode::Script)
+            text.replace('\\', R"(\\)");
+        text.replace('\n', R"(\n)");
+        text.replace('\t', R"(\t)");
+        if (mode == EscapeMode::Script)
+            text.replace('"', R"(\")");
+        return text;
+    }
+
+private slots:
+    void escape_data();
+    void escape();
+    void specialPositions_data();
+    void specialPositions();
+    void random();
+};
+
+void TestStringEscape::escape_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("script");
+    QTest::addColumn<QString>("display");
+
+    QTest::newRow("empty") << QString() << QString() << QString();
+    QTest::newRow("plain") << QString("abc") << QString("abc") << QString("abc");
+    QTest::newRow("specials") << QString("a\n\t\\\"b") << QString(R"(a\n\t\\\"b)") << QString(R"(a\n\t\"b)");
+    QTest::newRow("only specials") << QString("\"\"\"\"\"\"\"\"\"") << QString(R"(\"\"\"\"\"\"\"\"\")")
+                                   << QString("\"\"\"\"\"\"\"\"\"");
+    // Characters with a special character in one of their bytes
+    const QString highBytes = QString::fromUtf16(u"\u0A0A\u5C5C\u0922\u0A00");
+    QTest::newRow("high bytes") << highBytes << highBytes << highBytes;
+}
+
+void TestStringEscape::escape()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, script);
+    QFETCH(QString, display);
+
+    QCOMPARE(escaped(text, EscapeMode::Script), script);
+    QCOMPARE(escaped(text, EscapeMode::Display), display);
+
+    QString output = "prefix";
+    appendEscaped(output, text, EscapeMode::Script);
+    QCOMPARE(output, "prefix" + script);
+}
+
+void TestStringEscape::specialPositions_data()
+{
+    QTest::addColumn<QChar>("special");
+
+    QTest::newRow("new line") << QChar(u'\n');
+    QTest::newRow("tab") << QChar(u'\t');
+    QTest::newRow("backslash") << QChar(u'\\');
+    QTest::newRow("quote") << QChar(u'"');
+}
+
+// A special character at each position, around the 8 characters blocks and in the tail
+void TestStringEscape::specialPositions()
+{
+    QFETCH(QChar, special);
+
+    const QString buffer(64, u'a');
+    for (qsizetype offset = 0; offset < 8; ++offset) {
+        for (qsizetype length = 0; length <= 40; ++length) {
+            for (qsizetype position = 0; position < length; ++position) {
+                QString text = buffer.left(offset + length);
+                text[offset + position] = special;
+                // Unaligned views, as in a larger string
+                const QStringView view = QStringView(text).mid(offset);
+                for (auto mode : {EscapeMode::Script, EscapeMode::Display}) {
+                    const QString expected = reference(view.toString(), mode);
+                    if (escaped(view, mode) != expected) {
+                        QFAIL(qPrintable(QString("offset %1, length %2, position %3, mode %4")
+                                             .arg(offset)
+                                             .arg(length)
+                                             .arg(position)
+                                             .arg(static_cast<int>(mode))));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TestStringEscape::random()
+{
+    const char16_t alphabet[] = {u'a', u'\n', u'\t', u'\\', u'"', u' ', u'\u0A0A', u'\u5C5C', 0xD83D, 0xDE00};
+    QRandomGenerator generator(42);
+    for (int i = 0; i < 2000; ++i) {
+        QString text(generator.bounded(100), Qt::Uninitialized);
+        for (auto &c : text) {
+            // Mostly plain text
+            const int letter = generator.bounded(4 * static_cast<int>(std::size(alphabet)));
+            c = letter < static_cast<int>(std::size(alphabet)) ? QChar(alphabet[letter]) : QChar(u'x');
+        }
+        for (auto mode : {EscapeMode::Script, EscapeMode::Display})
+            QCOMPARE(escaped(text, mode), reference(text, mode));
+    }
+}
+
+QTEST_MAIN(TestStringEscape)
+#include "tst_stringescape.moc"
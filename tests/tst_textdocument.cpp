@@ -0,0 +1,127 @@
+#include "logger.h"
+#include "textdocument.h"
+
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+#include <QTextBlock>
+#include <QTest>
+
+using Starts = std::vector<qsizetype>;
+
+class TestTextDocument : public QObject
+{
+    Q_OBJECT
+
+private:
+    static Starts starts(const std::vector<TextDocument::Match> &matches)
+    {
+        Starts result;
+        for (const auto &match : matches)
+            result.push_back(match.start);
+        return result;
+    }
+
+    // Each fragment is a piece of its own, so occurrences are split across the chunks of the document
+    static void setFragments(TextDocument &document, const QStringList &fragments)
+    {
+        document.setText({});
+        for (auto it = fragments.crbegin(); it != fragments.crend(); ++it) {
+            document.gotoStartOfDocument();
+            document.insert(*it);
+        }
+    }
+
+private slots:
+    void initTestCase();
+
+    void insertIntoEmpty();
+    void matches_data();
+    void matches();
+    void replaceAll();
+    void replaceAllKeepsText();
+};
+
+void TestTextDocument::initTestCase()
+{
+    LoggerObject::setLevel(LoggerObject::Level::Record);
+}
+
+void TestTextDocument::insertIntoEmpty()
+{
+    TextDocument document;
+    document.insert("ab");
+    document.insert("c");
+    QCOMPARE(document.text(), QString("abc"));
+
+    document.setText("");
+    document.insert("d");
+    QCOMPARE(document.text(), QString("d"));
+}
+
+void TestTextDocument::matches_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("flags");
+
+    QTest::newRow("plain") << QString("foo") << 0;
+    QTest::newRow("case sensitive") << QString("Foo") << int(TextDocument::FindCaseSensitively);
+    QTest::newRow("whole words") << QString("foo") << int(TextDocument::FindWholeWords);
+    QTest::newRow("whole words, case sensitive")
+        << QString("foo") << int(TextDocument::FindWholeWords | TextDocument::FindCaseSensitively);
+    QTest::newRow("line break") << QString("o\nf") << 0;
+    QTest::newRow("one character") << QString("o") << int(TextDocument::FindWholeWords);
+    QTest::newRow("longer than the chunks") << QString("foo, foo foo") << 0;
+    QTest::newRow("not found") << QString("bar") << 0;
+}
+
+// The chunked search gives the same occurrences as a regular expression on the whole text
+void TestTextDocument::matches()
+{
+    QFETCH(QString, text);
+    QFETCH(int, flags);
+
+    TextDocument document;
+    setFragments(document, {"fo", "o f", "oo_f", "oo Fo", "O\n", "f", "oo", ", foo foo", " xfoo\nfoo"});
+    QCOMPARE(document.text(), QString("foo foo_foo FoO\nfoo, foo foo xfoo\nfoo"));
+
+    const auto flagsValue = TextDocument::FindFlags(flags);
+    const auto expected = document.matches(QRegularExpression::escape(text),
+                                           flagsValue | TextDocument::FindRegularExpression);
+    QCOMPARE(starts(document.matches(text, flagsValue)), starts(expected));
+}
+
+void TestTextDocument::replaceAll()
+{
+    TextDocument document;
+    setFragments(document, {"ab", "c abc", " a", "bc"});
+    document.gotoStartOfDocument();
+    document.gotoNextChar(5);
+    document.selectNextChar(2);
+
+    QCOMPARE(document.replaceAll("abc", "x", TextDocument::FindWholeWords), 3);
+    QCOMPARE(document.text(), QString("x x x"));
+    // A cursor inside the replaced text goes to its end
+    QCOMPARE(document.selectedText(), QString());
+    QCOMPARE(document.replaceAll("x", "yz"), 3);
+    QCOMPARE(document.text(), QString("yz yz yz"));
+    QCOMPARE(document.replaceAll("(y)(z)", "\\2\\1", TextDocument::FindRegularExpression), 3);
+    QCOMPARE(document.text(), QString("zy zy zy"));
+}
+
+// The text between the occurrences is not the searched text, where they are replaced by spaces and line breaks
+void TestTextDocument::replaceAllKeepsText()
+{
+    QPlainTextEdit textEdit;
+    TextDocument document(&textEdit);
+    const QString text = QString("a") + QChar::Nbsp + "a" + QChar::LineSeparator + "a\na";
+    document.setText(text);
+
+    QCOMPARE(document.count("a a"), 1);
+    QCOMPARE(document.replaceAll("a", "bc"), 4);
+    const QString expected = QString("bc") + QChar::Nbsp + "bc" + QChar::LineSeparator + "bc";
+    QCOMPARE(textEdit.document()->firstBlock().text(), expected);
+    QCOMPARE(textEdit.document()->lastBlock().text(), QString("bc"));
+}
+
+QTEST_MAIN(TestTextDocument)
+#include "tst_textdocument.moc"